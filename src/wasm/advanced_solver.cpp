@@ -3,24 +3,29 @@
  * Author: game-coder-maker
  * 1500+ lines, glitch/debug free, production grade, WASM compatible
  * Features:
- * - Multi-stage solving with progressive tile locking
+ * - Multi-stage solving with progressive tile locking, plus an optimal mode
  * - Multi-level pattern database (PDB) heuristics
  * - Bidirectional and multi-threaded search
- * - Symmetry and duplicate pruning
- * - Transposition tables (thread-safe)
+ * - Duplicate-sequence pruning and reflected (symmetric) PDB lookups
  * - Robust diagnostics, validation, debug, test utility
  * - Animation compatibility, memory safety, exception handling
  */
 
+#ifdef __EMSCRIPTEN__
 #include <emscripten.h>
+#else
+#define EMSCRIPTEN_KEEPALIVE // native builds (pdb_generator.cpp) export nothing
+#endif
 #include <vector>
 #include <queue>
+#include <deque>
 #include <unordered_set>
 #include <unordered_map>
 #include <map>
-#include <set>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <system_error>
 #include <atomic>
 #include <chrono>
 #include <algorithm>
@@ -33,6 +38,16 @@
 #include <cstring>
 #include <cmath>
 #include <future>
+#include <array>
+#include <tuple>
+#include <climits>
+#include <memory>
+#include <cstddef>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // --- WASM Interop ---
 extern "C" {
@@ -55,384 +70,2328 @@ std::string vec2str(const std::vector<uint8_t>& v) {
     return oss.str();
 }
 
-// --- Puzzle State ---
+// --- Zobrist keys ---
+// One random 64-bit key per (tile, cell), generated at compile time with
+// splitmix64. The blank's keys are zero, so a state's key is the XOR over the
+// real tiles and a move updates it with two XORs.
+template<int N>
+struct ZobristTable {
+    static constexpr uint64_t splitmix64(uint64_t& x) {
+        uint64_t z=(x+=0x9E3779B97F4A7C15ull);
+        z=(z^(z>>30))*0xBF58476D1CE4E5B9ull;
+        z=(z^(z>>27))*0x94D049BB133111EBull;
+        return z^(z>>31);
+    }
+    static constexpr std::array<std::array<uint64_t,N>,N> build() {
+        std::array<std::array<uint64_t,N>,N> t{};
+        uint64_t seed=0x5EED0000ull+N;
+        for(int v=1;v<N;++v) for(int i=0;i<N;++i) t[v][i]=splitmix64(seed);
+        return t;
+    }
+    static constexpr std::array<std::array<uint64_t,N>,N> keys=build();
+};
+
+// --- Puzzle State (packed bitboard) ---
+// Tiles are stored as fixed-width fields of one packed word: 4-bit nibbles in a
+// uint64_t for 4x4, 5-bit fields in an unsigned __int128 for 5x5. Board
+// dimensions are template parameters, so cell counts, field widths and the goal
+// word are compile-time constants. Copying a state is a register copy and
+// equality is a single compare.
+template<int R,int C>
 struct PuzzleState {
-    std::vector<uint8_t> tiles;
-    int size;
+    static constexpr int N=R*C;
+    static constexpr int BITS=N<=16?4:5;
+    typedef typename std::conditional<N*BITS<=64,uint64_t,unsigned __int128>::type word_t;
+    static constexpr word_t MASK=(1u<<BITS)-1;
+    static constexpr word_t goal_board() {
+        word_t b=0;
+        for(int i=0;i<N-1;++i) b|=(word_t)(i+1)<<(i*BITS);
+        return b;
+    }
+    static constexpr word_t GOAL=goal_board();
+    typedef ZobristTable<N> Zobrist;
+
+    word_t board;
+    uint64_t zkey; // Zobrist key, maintained incrementally
     int empty;
-    PuzzleState(int sz): tiles(sz*sz,0), size(sz), empty(-1) {}
-    PuzzleState(const uint8_t* arr, int sz): tiles(arr,arr+sz*sz), size(sz) {
-        for(int i=0;i<sz*sz;++i) if(tiles[i]==0) empty=i;
-    }
-    bool isSolved() const {
-        for(int i=0;i<size*size-1;++i) if(tiles[i]!=i+1) return false;
-        return tiles[size*size-1]==0;
-    }
-    bool operator==(const PuzzleState& o) const { return tiles==o.tiles; }
-    bool operator!=(const PuzzleState& o) const { return tiles!=o.tiles; }
-    bool operator<(const PuzzleState& o) const { return tiles<o.tiles; }
-    std::string key() const { return std::string((char*)tiles.data(),tiles.size()); }
-    int hash() const { size_t h=0; for(auto t:tiles) h=h*31+t; return h; }
+    uint8_t pos[N]; // inverse index: pos[v] is the cell holding tile v
+    PuzzleState(): board(0), zkey(0), empty(-1), pos{} {}
+    // arr must be a permutation of 0..N-1: tile values index pos and the
+    // Zobrist keys. Boards from outside are checked with valid_tiles first.
+    explicit PuzzleState(const uint8_t* arr): PuzzleState() {
+        for(int i=0;i<N;++i) {
+            set(i,arr[i]);
+            if(arr[i]==0) empty=i;
+        }
+    }
+    explicit PuzzleState(const std::vector<uint8_t>& t): PuzzleState(t.data()) {}
+    static PuzzleState goal() {
+        PuzzleState g;
+        g.board=GOAL;
+        g.empty=N-1;
+        for(int v=1;v<N;++v) {
+            g.pos[v]=v-1;
+            g.zkey^=Zobrist::keys[v][v-1];
+        }
+        g.pos[0]=N-1;
+        return g;
+    }
+    uint8_t at(int i) const { return (uint8_t)((board>>(i*BITS))&MASK); }
+    void set(int i,uint8_t v) {
+        zkey^=Zobrist::keys[at(i)][i]^Zobrist::keys[v][i];
+        board=(board&~(MASK<<(i*BITS)))|((word_t)v<<(i*BITS));
+        pos[v]=i;
+    }
+    // Slide the tile at ni into the blank. The blank field is zero, so the swap
+    // is one mask-out and one or-in of the moved tile's field.
+    void slide(int ni) {
+        word_t v=(board>>(ni*BITS))&MASK;
+        board&=~(v<<(ni*BITS));
+        board|=v<<(empty*BITS);
+        zkey^=Zobrist::keys[(int)v][ni]^Zobrist::keys[(int)v][empty];
+        pos[v]=empty;
+        pos[0]=ni;
+        empty=ni;
+    }
+    // Slide tile v into the blank, wherever it is; O(1) through the index.
+    void move_tile(uint8_t v) { slide(pos[v]); }
+    static constexpr bool adjacent(int a,int b) {
+        int d=a>b?a-b:b-a;
+        return d==C || (d==1 && a/C==b/C);
+    }
+    std::vector<uint8_t> tiles() const {
+        std::vector<uint8_t> t(N);
+        for(int i=0;i<N;++i) t[i]=at(i);
+        return t;
+    }
+    bool isSolved() const { return board==GOAL; }
+    bool operator==(const PuzzleState& o) const { return board==o.board; }
+    bool operator!=(const PuzzleState& o) const { return board!=o.board; }
+    bool operator<(const PuzzleState& o) const { return board<o.board; }
+    std::string key() const { auto t=tiles(); return std::string((char*)t.data(),t.size()); }
+    uint64_t hash() const { return zkey; }
 };
 
 // --- Hash for unordered_set/map ---
 struct PuzzleHash {
-    size_t operator()(const PuzzleState& p) const {
-        size_t h=0;
-        for(auto t:p.tiles) h=h*31+t;
-        return h;
-    }
+    template<int R,int C>
+    size_t operator()(const PuzzleState<R,C>& p) const { return (size_t)p.zkey; }
 };
 
 // --- Move Directions ---
-const int dir4[4][2] = {{-1,0},{1,0},{0,-1},{0,1}};
+constexpr int dir4[4][2] = {{-1,0},{1,0},{0,-1},{0,1}};
 const char dirChar[4] = {'U','D','L','R'};
 
+// --- Move tables ---
+// For every blank position, the cells the blank can move to and the direction
+// of each move, built at compile time. Directions are paired so that the
+// reverse of move d is d^1.
+template<int R,int C>
+struct MoveTable {
+    struct Move { uint8_t to; uint8_t dir; };
+    struct Cell { uint8_t count; Move moves[4]; };
+    static constexpr int opposite(int d) { return d^1; }
+    static constexpr std::array<Cell,R*C> build() {
+        std::array<Cell,R*C> t{};
+        for(int i=0;i<R*C;++i) {
+            int r=i/C, c=i%C;
+            for(int d=0;d<4;++d) {
+                int nr=r+dir4[d][0], nc=c+dir4[d][1];
+                if(nr<0||nr>=R||nc<0||nc>=C) continue;
+                t[i].moves[t[i].count++]={(uint8_t)(nr*C+nc),(uint8_t)d};
+            }
+        }
+        return t;
+    }
+    static constexpr std::array<Cell,R*C> cells=build();
+    // The same table without the moves into locked cells (bit i is cell i), so
+    // a search on a partly locked board never generates them.
+    static std::array<Cell,R*C> open(uint32_t locked) {
+        std::array<Cell,R*C> t{};
+        for(int i=0;i<R*C;++i)
+            for(int k=0;k<cells[i].count;++k)
+                if(!(locked>>cells[i].moves[k].to&1)) t[i].moves[t[i].count++]=cells[i].moves[k];
+        return t;
+    }
+};
+
+// --- Duplicate-sequence pruning automaton ---
+// A finite-state machine over move directions in the style of Taylor & Korf.
+// Enumerating blank paths of up to DEPTH moves on an open grid finds strings S
+// that reach the same configuration as an earlier string T in (length, lex)
+// order. S is forbidden only when T's blank visits a subset of the cells S
+// visits: T is then legal wherever S is, whatever the board edges or locked
+// cells, so one automaton serves every board size and lock mask. The minimal
+// forbidden strings (the immediate reversals are the shortest) are compiled
+// into an Aho-Corasick automaton; the searches carry its state and never
+// generate a move that completes a forbidden string. The enumeration takes a
+// few hundred milliseconds, so it runs offline (pdb_generator --fsm) and the
+// compiled transitions are embedded from move_fsm.inc.
+class MoveFSM {
+public:
+    static constexpr int DEPTH=10;
+    static const MoveFSM& get() { static const MoveFSM fsm; return fsm; }
+    // Automaton state after moving in direction d from state q, or -1 when the
+    // move completes a forbidden string. The start state is 0.
+    int next(int q,int d) const { return table[q*4+d]; }
+    static constexpr int states() { return sizeof table/sizeof table[0]/4; }
+
+    // Enumerates and compiles the automaton from scratch: four transitions
+    // per state, state 0 first.
+    static std::vector<int16_t> generate() {
+        Generator g;
+        g.discover();
+        g.compile();
+        return g.trans;
+    }
+    // Whether the embedded table is the one generate() produces.
+    static bool verify() {
+        std::vector<int16_t> t=generate();
+        return t.size()==sizeof table/sizeof table[0] && std::equal(t.begin(),t.end(),table);
+    }
+
+private:
+    static constexpr int16_t table[]={
+#include "move_fsm.inc"
+    };
+
+    // A path of len moves packed two bits per move, first move highest, with
+    // the length in the upper word so paths of different lengths never clash.
+    typedef uint64_t Path;
+    static Path make(int len,uint32_t code) { return ((uint64_t)len<<32)|code; }
+    static int length(Path p) { return (int)(p>>32); }
+    static uint32_t code(Path p) { return (uint32_t)p; }
+    static constexpr int W=2*DEPTH+3, ORIGIN=(DEPTH+1)*W+DEPTH+1;
+    // Configuration reached by a path: the cells whose content changed (with
+    // the content) and the cells the blank visited, both sorted.
+    struct Trace { std::vector<std::pair<int,int>> moved; std::vector<int> visited; uint64_t key; };
+
+    static uint64_t mix(uint64_t x) { return ZobristTable<1>::splitmix64(x); }
+    static Trace replay(Path p) {
+        static thread_local std::vector<int> grid;
+        if(grid.empty()) for(int i=0;i<W*W;++i) grid.push_back(i);
+        Trace t;
+        int b=ORIGIN;
+        t.visited.push_back(b);
+        for(int i=length(p)-1;i>=0;--i) {
+            int d=(code(p)>>(2*i))&3, nb=b+dir4[d][0]*W+dir4[d][1];
+            std::swap(grid[b],grid[nb]);
+            b=nb;
+            t.visited.push_back(b);
+        }
+        std::sort(t.visited.begin(),t.visited.end());
+        t.visited.erase(std::unique(t.visited.begin(),t.visited.end()),t.visited.end());
+        t.key=0;
+        for(int c:t.visited) if(grid[c]!=c) {
+            t.moved.push_back({c,grid[c]});
+            t.key^=mix(((uint64_t)c<<32)|grid[c]);
+        }
+        for(int c:t.visited) grid[c]=c;
+        return t;
+    }
+
+    struct Generator {
+        std::vector<int16_t> trans;
+        std::unordered_set<Path> forbidden;
+
+        bool has_forbidden_suffix(Path p) const {
+            for(int l=2;l<=length(p);++l) if(forbidden.count(make(l,code(p)&((1u<<(2*l))-1)))) return true;
+            return false;
+        }
+        // Level-by-level enumeration in (length, lex) order. Strings that
+        // contain a forbidden string are never extended, so the first string
+        // to reach a configuration is its minimal one.
+        void discover() {
+            std::vector<Path> alive{make(0,0)}, level{make(0,0)};
+            std::unordered_map<uint64_t,std::vector<size_t>> seen;
+            seen[replay(make(0,0)).key].push_back(0);
+            for(int len=1;len<=DEPTH;++len) {
+                std::vector<Path> next;
+                for(Path p:level) for(uint32_t d=0;d<4;++d) {
+                    Path s=make(len,code(p)<<2|d);
+                    if(has_forbidden_suffix(s)) continue;
+                    Trace ts=replay(s);
+                    bool dup=false;
+                    for(size_t ti:seen[ts.key]) {
+                        Trace tt=replay(alive[ti]);
+                        if(tt.moved==ts.moved && std::includes(ts.visited.begin(),ts.visited.end(),tt.visited.begin(),tt.visited.end())) {dup=true;break;}
+                    }
+                    if(dup) {forbidden.insert(s);continue;}
+                    seen[ts.key].push_back(alive.size());
+                    alive.push_back(s);
+                    next.push_back(s);
+                }
+                level.swap(next);
+            }
+        }
+        // Strings go into the trie in sorted order so the state numbering,
+        // and with it the embedded table, does not depend on hash order.
+        void compile() {
+            std::vector<Path> sorted(forbidden.begin(),forbidden.end());
+            std::sort(sorted.begin(),sorted.end());
+            std::vector<std::array<int,4>> go(1,{-1,-1,-1,-1});
+            std::vector<char> term(1,0);
+            for(Path p:sorted) {
+                int q=0;
+                for(int i=length(p)-1;i>=0;--i) {
+                    int d=(code(p)>>(2*i))&3;
+                    if(go[q][d]<0) {
+                        go[q][d]=go.size();
+                        go.push_back({-1,-1,-1,-1});
+                        term.push_back(0);
+                    }
+                    q=go[q][d];
+                }
+                term[q]=1;
+            }
+            std::vector<int> fail(go.size(),0), order;
+            for(int d=0;d<4;++d) {
+                if(go[0][d]<0) go[0][d]=0;
+                else order.push_back(go[0][d]);
+            }
+            for(size_t i=0;i<order.size();++i) {
+                int u=order[i];
+                term[u]|=term[fail[u]];
+                for(int d=0;d<4;++d) {
+                    int v=go[u][d];
+                    if(v<0) go[u][d]=go[fail[u]][d];
+                    else { fail[v]=go[fail[u]][d]; order.push_back(v); }
+                }
+            }
+            assert(go.size()<INT16_MAX);
+            trans.resize(go.size()*4);
+            for(size_t q=0;q<go.size();++q) for(int d=0;d<4;++d)
+                trans[q*4+d]=term[go[q][d]]?-1:(int16_t)go[q][d];
+        }
+    };
+};
+
 // --- Manhattan Distance ---
-int manhattan(const PuzzleState& state) {
-    int sz=state.size;
-    int dist=0;
-    for(int i=0;i<sz*sz;++i) {
-        uint8_t v=state.tiles[i];
-        if(v==0) continue;
-        int gi=v-1, gr=gi/sz, gc=gi%sz;
-        int cr=i/sz, cc=i%sz;
-        dist+=abs(gr-cr)+abs(gc-cc);
+// dist[v][i] is the Manhattan distance of tile v standing on cell i, so a move
+// that slides tile v from cell a to cell b changes h by delta(v,a,b) and the
+// searches can carry h down the tree instead of rescanning the board.
+template<int R,int C>
+struct ManhattanTable {
+    static constexpr std::array<std::array<int8_t,R*C>,R*C> build() {
+        std::array<std::array<int8_t,R*C>,R*C> t{};
+        for(int v=1;v<R*C;++v) for(int i=0;i<R*C;++i) {
+            int gr=(v-1)/C, gc=(v-1)%C, cr=i/C, cc=i%C;
+            t[v][i]=(int8_t)((gr>cr?gr-cr:cr-gr)+(gc>cc?gc-cc:cc-gc));
+        }
+        return t;
     }
+    static constexpr std::array<std::array<int8_t,R*C>,R*C> dist=build();
+    static int delta(int v,int from,int to) { return dist[v][to]-dist[v][from]; }
+};
+
+template<int R,int C>
+int manhattan(const PuzzleState<R,C>& state) {
+    int dist=0;
+    for(int v=1;v<R*C;++v) dist+=ManhattanTable<R,C>::dist[v][state.pos[v]];
     return dist;
 }
 
-// --- Symmetry helpers ---
-std::vector<uint8_t> rotate90(const std::vector<uint8_t>& t,int sz) {
-    std::vector<uint8_t> res(sz*sz,0);
-    for(int r=0;r<sz;r++) for(int c=0;c<sz;c++)
-        res[c*sz+sz-1-r]=t[r*sz+c];
-    return res;
-}
-std::vector<uint8_t> reflect_h(const std::vector<uint8_t>& t,int sz) {
-    std::vector<uint8_t> res(sz*sz,0);
-    for(int r=0;r<sz;r++) for(int c=0;c<sz;c++)
-        res[r*sz+sz-1-c]=t[r*sz+c];
-    return res;
-}
-std::vector<std::vector<uint8_t>> all_symmetries(const std::vector<uint8_t>& t,int sz) {
-    std::vector<std::vector<uint8_t>> res;
-    res.push_back(t);
-    auto r90=rotate90(t,sz); res.push_back(r90);
-    auto r180=rotate90(r90,sz); res.push_back(r180);
-    auto r270=rotate90(r180,sz); res.push_back(r270);
-    res.push_back(reflect_h(t,sz));
-    res.push_back(reflect_h(r90,sz));
-    res.push_back(reflect_h(r180,sz));
-    res.push_back(reflect_h(r270,sz));
-    return res;
-}
+// --- Linear conflict ---
+// Each row (column) is indexed by its packed contents: one base-(C+1) digit per
+// cell holding the goal column+1 of a tile that belongs in that row, 0 for the
+// blank and for other tiles. The per-line table gives 2*(k-LIS) for the k
+// resident tiles, the moves they need beyond Manhattan to pass each other.
+// Only the tiles in a mask contribute, so stage 1 can bound just its own tiles.
+template<int R,int C>
+struct LinearConflict {
+    static constexpr int N=R*C;
+    static constexpr int pow(int b,int e) { return e?b*pow(b,e-1):1; }
+    static constexpr int ROW_SIZE=pow(C+1,C), COL_SIZE=pow(R+1,R);
+
+    template<int LEN,int SIZE>
+    static constexpr std::array<int8_t,SIZE> build() {
+        std::array<int8_t,SIZE> t{};
+        for(int idx=0;idx<SIZE;++idx) {
+            int digit[LEN]={}, lis[LEN]={}, k=0, best=0;
+            for(int p=0,x=idx;p<LEN;++p,x/=LEN+1) digit[p]=x%(LEN+1);
+            for(int p=0;p<LEN;++p) {
+                if(!digit[p]) continue;
+                ++k; lis[p]=1;
+                for(int q=0;q<p;++q) if(digit[q] && digit[q]<digit[p] && lis[q]+1>lis[p]) lis[p]=lis[q]+1;
+                best=std::max(best,lis[p]);
+            }
+            t[idx]=(int8_t)(2*(k-best));
+        }
+        return t;
+    }
+    static constexpr std::array<int8_t,ROW_SIZE> rows=build<C,ROW_SIZE>();
+    static constexpr std::array<int8_t,COL_SIZE> cols=build<R,COL_SIZE>();
+
+    // Lines 0..R-1 are rows, R..R+C-1 columns; h is Manhattan plus conflicts
+    // over the masked tiles.
+    struct Lines { uint16_t idx[R+C]; int16_t md; int16_t conflict; int h() const { return md+conflict; } };
+
+    uint16_t row_part[N][N], col_part[N][N];
+    uint32_t mask;
+
+    explicit LinearConflict(uint32_t tile_mask=~0u): row_part{}, col_part{}, mask(tile_mask&~1u) {
+        for(int v=1;v<N;++v) {
+            if(!(mask>>v&1)) continue;
+            int gr=(v-1)/C, gc=(v-1)%C;
+            for(int c=0;c<C;++c) row_part[v][gr*C+c]=(uint16_t)((gc+1)*pow(C+1,c));
+            for(int r=0;r<R;++r) col_part[v][r*C+gc]=(uint16_t)((gr+1)*pow(R+1,r));
+        }
+    }
+
+    static int value(int line,int idx) { return line<R?rows[idx]:cols[idx]; }
 
-// --- Transposition Table ---
-template<typename S>
-class TranspositionTable {
-    std::unordered_set<S, PuzzleHash> table;
-    std::mutex mtx;
+    Lines of(const PuzzleState<R,C>& s) const {
+        Lines l{};
+        for(int v=1;v<N;++v) {
+            if(!(mask>>v&1)) continue;
+            int i=s.pos[v];
+            l.idx[i/C]+=row_part[v][i];
+            l.idx[R+i%C]+=col_part[v][i];
+            l.md+=ManhattanTable<R,C>::dist[v][i];
+        }
+        for(int line=0;line<R+C;++line) l.conflict+=value(line,l.idx[line]);
+        return l;
+    }
+
+    // Tile v slid from cell `from` to cell `to`. A horizontal move keeps the
+    // tile's order within its row, so only the two columns need a new lookup
+    // (and vice versa); the untouched line just has its index shifted.
+    void update(Lines& l,const PuzzleState<R,C>&,int v,int from,int to) const {
+        if(!(mask>>v&1)) return;
+        l.md+=ManhattanTable<R,C>::delta(v,from,to);
+        shift(l,from/C,to/C,row_part[v][from],row_part[v][to]);
+        shift(l,R+from%C,R+to%C,col_part[v][from],col_part[v][to]);
+    }
+    static void shift(Lines& l,int a,int b,int out,int in) {
+        if(a==b) {l.idx[a]+=in-out;return;}
+        l.conflict-=value(a,l.idx[a])+value(b,l.idx[b]);
+        l.idx[a]-=out; l.idx[b]+=in;
+        l.conflict+=value(a,l.idx[a])+value(b,l.idx[b]);
+    }
+};
+
+// --- Walking distance ---
+// Takahashi's walking distance along one axis of L lines of W cells. Line i is
+// summarised by a code with one base-(W+1) digit per goal line g, counting the
+// tiles in line i that belong in line g. Only blank moves across lines change
+// the codes, so a BFS over (codes, blank line) from the goal gives a lower
+// bound on the moves along this axis. The count matrices are ranked line by
+// line: base[] holds, per remaining goal-line totals, how many matrices start
+// with a smaller code, so a rank costs L-1 lookups and needs no hash table.
+template<int L,int W>
+class WalkingDistanceTable {
 public:
-    bool exists(const S& s) {
-        std::lock_guard<std::mutex> lock(mtx);
-        return table.count(s)>0;
+    static constexpr int pow(int b,int e) { return e?b*pow(b,e-1):1; }
+    static constexpr int BASE=W+1, CODES=pow(BASE,L);
+    static constexpr uint8_t UNSEEN=0xFF;
+    static_assert(CODES<=(1<<13) && 3+13*(L-1)<=64,"line codes must pack into one word");
+    typedef std::array<uint16_t,L> Codes;
+
+    static constexpr int weight(int g) { return pow(BASE,g); }
+    static int digit(int code,int g) { return code/weight(g)%BASE; }
+    static int line_size(int i,int blank) { return W-(i==blank); }
+    static int goal_size(int g) { return W-(g==L-1); }
+    static Codes goal() {
+        Codes c{};
+        for(int g=0;g<L;++g) c[g]=goal_size(g)*weight(g);
+        return c;
     }
-    void insert(const S& s) {
-        std::lock_guard<std::mutex> lock(mtx);
-        table.insert(s);
+
+    static const WalkingDistanceTable& get() { static const WalkingDistanceTable wd; return wd; }
+    int lookup(const Codes& c,int blank) const { return table[rank(c,blank)]; }
+    size_t size() const { return table.size(); }
+
+    uint32_t rank(const Codes& c,int blank) const {
+        uint32_t r=offset[blank];
+        int left=goal_code;
+        for(int i=0;i<L-1;++i) {
+            const Level& lv=levels[blank][i];
+            r+=lv.base[lv.id[left]*comps[line_size(i,blank)]+comp[c[i]]];
+            left-=c[i]; // digit-wise: a line never holds more than remains
+        }
+        return r;
     }
-    void clear() {
-        std::lock_guard<std::mutex> lock(mtx);
-        table.clear();
+
+private:
+    struct Level { std::vector<int32_t> id; std::vector<uint32_t> base; };
+    int goal_code=0;
+    int comp[CODES], comps[W+1]={};
+    uint32_t offset[L+1]={};
+    Level levels[L][L-1];
+    std::vector<uint8_t> table;
+
+    static bool fits(int code,int left) {
+        for(int g=0;g<L;++g) if(digit(code,g)>digit(left,g)) return false;
+        return true;
+    }
+
+    WalkingDistanceTable() {
+        int sum[CODES];
+        for(int code=0;code<CODES;++code) {
+            sum[code]=0;
+            for(int g=0;g<L;++g) sum[code]+=digit(code,g);
+            comp[code]=sum[code]<=W?comps[sum[code]]++:-1;
+        }
+        for(int g=0;g<L;++g) goal_code+=goal_size(g)*weight(g);
+        for(int blank=0;blank<L;++blank) {
+            // Totals left after each prefix of lines, then completion counts
+            // bottom-up; the last line is forced, so each of its totals counts 1.
+            std::vector<std::vector<int>> left(L);
+            left[0]={goal_code};
+            for(int i=0;i<L-1;++i) {
+                Level& lv=levels[blank][i];
+                lv.id.assign(CODES,-1);
+                for(size_t j=0;j<left[i].size();++j) lv.id[left[i][j]]=j;
+                std::vector<bool> seen(CODES,false);
+                for(int t:left[i]) for(int code=0;code<CODES;++code)
+                    if(sum[code]==line_size(i,blank) && fits(code,t) && !seen[t-code]) {seen[t-code]=true;left[i+1].push_back(t-code);}
+            }
+            std::vector<uint32_t> below(CODES,1), here(CODES,0);
+            for(int i=L-2;i>=0;--i) {
+                Level& lv=levels[blank][i];
+                int n=line_size(i,blank);
+                lv.base.assign(left[i].size()*comps[n],0);
+                for(size_t j=0;j<left[i].size();++j) {
+                    int t=left[i][j];
+                    uint32_t total=0;
+                    for(int code=0;code<CODES;++code) {
+                        if(sum[code]!=n || !fits(code,t)) continue;
+                        lv.base[j*comps[n]+comp[code]]=total;
+                        total+=below[t-code];
+                    }
+                    here[t]=total;
+                }
+                below.swap(here);
+            }
+            offset[blank+1]=offset[blank]+below[goal_code];
+        }
+        build();
     }
-    size_t size() {
-        std::lock_guard<std::mutex> lock(mtx);
-        return table.size();
+
+    // Level-synchronous BFS from the goal; frontier states pack the first L-1
+    // codes and the blank line (the last code is implied by the totals).
+    void build() {
+        table.assign(offset[L],UNSEEN);
+        auto pack=[](const Codes& c,int blank) {
+            uint64_t k=blank;
+            for(int i=0;i<L-1;++i) k|=(uint64_t)c[i]<<(3+13*i);
+            return k;
+        };
+        Codes c=goal();
+        std::vector<uint64_t> frontier{pack(c,L-1)}, next;
+        table[rank(c,L-1)]=0;
+        for(int depth=0;!frontier.empty();++depth) {
+            next.clear();
+            for(uint64_t k:frontier) {
+                int blank=k&7, last=goal_code;
+                for(int i=0;i<L-1;++i) {c[i]=k>>(3+13*i)&0x1FFF; last-=c[i];}
+                c[L-1]=last;
+                for(int nb:{blank-1,blank+1}) {
+                    if(nb<0 || nb>=L) continue;
+                    for(int g=0;g<L;++g) {
+                        if(!digit(c[nb],g)) continue;
+                        c[nb]-=weight(g); c[blank]+=weight(g);
+                        uint32_t r=rank(c,nb);
+                        if(table[r]==UNSEEN) {table[r]=depth+1; next.push_back(pack(c,nb));}
+                        c[nb]+=weight(g); c[blank]-=weight(g);
+                    }
+                }
+            }
+            frontier.swap(next);
+        }
     }
 };
 
-// --- Pattern Database (multi-level, compressed) ---
-std::unordered_map<std::string,int> pdb_4x4_stage1;
-std::unordered_map<std::string,int> pdb_5x5_stage1;
-std::unordered_map<std::string,int> pdb_5x5_stage2;
-
-void build_pdb(int sz,int ntiles,std::unordered_map<std::string,int>& pdb,int max_depth=14) {
-    std::queue<std::pair<std::vector<uint8_t>,int>> Q;
-    std::set<std::string> Seen;
-    std::vector<uint8_t> solved(sz*sz,0);
-    for(int i=0;i<ntiles;i++) solved[i]=i+1;
-    solved[sz*sz-1]=0;
-    Q.push({solved,0});
-    Seen.insert(std::string((char*)solved.data(),solved.size()));
-    while(!Q.empty()) {
-        auto [tiles,depth]=Q.front(); Q.pop();
-        std::string key((char*)tiles.data(),tiles.size());
-        pdb[key]=depth;
-        if(depth>=max_depth) continue;
-        int empty=-1;
-        for(int i=0;i<sz*sz;++i) if(tiles[i]==0) empty=i;
-        int r=empty/sz, c=empty%sz;
-        for(int d=0;d<4;++d) {
-            int nr=r+dir4[d][0], nc=c+dir4[d][1];
-            if(nr<0||nr>=sz||nc<0||nc>=sz) continue;
-            int ni=nr*sz+nc;
-            auto nt=tiles;
-            std::swap(nt[empty],nt[ni]);
-            bool valid=true;
-            for(int i=0;i<ntiles;i++) if(nt[i]!=i+1) valid=false;
-            if(!valid) continue;
-            std::string nk((char*)nt.data(),nt.size());
-            if(Seen.count(nk)) continue;
-            Seen.insert(nk);
-            Q.push({nt,depth+1});
+// Rows bound the vertical moves and columns the horizontal ones, so their sum
+// bounds the solve. A vertical move changes two row codes and only the row
+// table is read again; horizontal moves likewise touch only the columns.
+template<int R,int C>
+struct WalkingDistance {
+    typedef WalkingDistanceTable<R,C> Rows;
+    typedef WalkingDistanceTable<C,R> Cols;
+    struct Lines {
+        typename Rows::Codes row; typename Cols::Codes col; uint8_t hr, hc;
+        int h() const { return hr+hc; }
+    };
+
+    static Lines of(const PuzzleState<R,C>& s) {
+        Lines l{};
+        for(int v=1;v<R*C;++v) {
+            int i=s.pos[v];
+            l.row[i/C]+=Rows::weight((v-1)/C);
+            l.col[i%C]+=Cols::weight((v-1)%C);
+        }
+        l.hr=Rows::get().lookup(l.row,s.empty/C);
+        l.hc=Cols::get().lookup(l.col,s.empty%C);
+        return l;
+    }
+    // Tile v slid from cell `from` into the blank at `to`.
+    static void update(Lines& l,const PuzzleState<R,C>&,int v,int from,int to) {
+        if(from/C!=to/C) {
+            int w=Rows::weight((v-1)/C);
+            l.row[from/C]-=w; l.row[to/C]+=w;
+            l.hr=Rows::get().lookup(l.row,from/C);
+        } else {
+            int w=Cols::weight((v-1)%C);
+            l.col[from%C]-=w; l.col[to%C]+=w;
+            l.hc=Cols::get().lookup(l.col,from%C);
         }
     }
+};
+
+template<int R,int C>
+int walking_distance(const PuzzleState<R,C>& state) {
+    return WalkingDistance<R,C>::of(state).h();
 }
 
-int pdb_heuristic(const PuzzleState& state,int stage,int sz) {
-    std::string key((char*)state.tiles.data(),state.tiles.size());
-    if(sz==4 && stage==1 && pdb_4x4_stage1.count(key)) return pdb_4x4_stage1[key];
-    if(sz==5 && stage==1 && pdb_5x5_stage1.count(key)) return pdb_5x5_stage1[key];
-    if(sz==5 && stage==2 && pdb_5x5_stage2.count(key)) return pdb_5x5_stage2[key];
-    return manhattan(state);
+// --- Goal-preserving symmetry ---
+// Reflecting a square board about its main diagonal maps the goal onto itself
+// once tiles are relabelled, so a state and its mirror image are equally far
+// from the goal and any lookup on the mirror is another admissible bound.
+// cell[i] is the mirror of cell i and tile[v] the relabelled tile v; both are
+// involutions and fix the blank, so the mirror's position index is
+// pos'[v] = cell[pos[tile[v]]] and no mirrored state is ever built.
+template<int R,int C>
+struct Reflection {
+    static_assert(R==C,"only square boards have a goal-preserving reflection");
+    static constexpr std::array<uint8_t,R*C> build_cells() {
+        std::array<uint8_t,R*C> t{};
+        for(int i=0;i<R*C;++i) t[i]=(uint8_t)((i%C)*C+i/C);
+        return t;
+    }
+    static constexpr std::array<uint8_t,R*C> build_tiles() {
+        std::array<uint8_t,R*C> t{};
+        for(int v=1;v<R*C;++v) t[v]=(uint8_t)(build_cells()[v-1]+1);
+        return t;
+    }
+    static constexpr std::array<uint8_t,R*C> cell=build_cells();
+    static constexpr std::array<uint8_t,R*C> tile=build_tiles();
+};
+
+// --- Parallel loops ---
+// Worker count for table builds: hardware threads unless a count is given.
+// With one worker the loops run inline, so single-threaded WASM builds never
+// start a thread.
+inline int worker_count(int requested=0) {
+    if(requested>0) return requested;
+    unsigned hw=std::thread::hardware_concurrency();
+    return hw?(int)hw:1;
 }
 
-// --- Locked positions ---
-std::set<int> get_locked_indices(const PuzzleState& state,int stage,int sz) {
-    std::set<int> locked;
-    if(sz==4 && stage==1) for(int i=0;i<6;++i) if(state.tiles[i]==i+1) locked.insert(i);
-    if(sz==5 && stage==1) for(int i=0;i<12;++i) if(state.tiles[i]==i+1) locked.insert(i);
-    return locked;
+// Calls f(begin,end) over [0,n) in chunks that the workers claim from a shared
+// cursor, so uneven chunks balance out; the calling thread is one worker.
+template<typename F>
+void parallel_for(size_t n,int threads,size_t chunk,F&& f) {
+    std::atomic<size_t> cursor(0);
+    auto work=[&]() {
+        for(size_t b;(b=cursor.fetch_add(chunk,std::memory_order_relaxed))<n;) f(b,std::min(n,b+chunk));
+    };
+    std::vector<std::thread> pool;
+    for(int t=1;t<threads;++t) pool.emplace_back(work);
+    work();
+    for(auto& th:pool) th.join();
 }
 
-// --- IDA* with advanced pruning and debug ---
-struct IDAResult {
-    std::vector<uint8_t> moves;
-    bool success;
-    int nodes;
-    int length;
-    std::string fail_reason;
+// One task deque per worker. A worker takes from the back of its own and,
+// once that is empty, steals from the front of the others'; tasks are
+// indices into the caller's task list.
+class TaskDeques {
+public:
+    explicit TaskDeques(int workers): queues(workers) {}
+    void push(int worker,size_t task) {
+        Queue& q=queues[worker];
+        std::lock_guard<std::mutex> lock(q.mu);
+        q.items.push_back(task);
+    }
+    bool pop(int worker,size_t& task) {
+        int n=(int)queues.size();
+        for(int i=0;i<n;++i) {
+            Queue& q=queues[(worker+i)%n];
+            std::lock_guard<std::mutex> lock(q.mu);
+            if(q.items.empty()) continue;
+            if(i==0) {task=q.items.back();q.items.pop_back();}
+            else {task=q.items.front();q.items.pop_front();}
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Queue { std::mutex mu; std::deque<size_t> items; };
+    std::vector<Queue> queues;
 };
 
-IDAResult ida_star(const PuzzleState& start,int sz,int max_depth,int stage=2,int node_limit=1000000,int time_limit_ms=20000,const std::set<int>& locked={}) {
-    auto start_time=std::chrono::high_resolution_clock::now();
-    int threshold=stage==1?pdb_heuristic(start,stage,sz):manhattan(start);
-    int nodes=0;
-    TranspositionTable<PuzzleState> TT;
-    std::vector<uint8_t> path;
-    bool found=false;
-    std::string fail_reason;
-    std::function<int(PuzzleState,int,int)> dfs=[&](PuzzleState state,int g,int prev_empty)->int {
-        nodes++;
-        if(nodes>node_limit) {fail_reason="node_limit";return INT_MAX;}
-        int h=stage==1?pdb_heuristic(state,stage,sz):manhattan(state);
-        int f=g+h;
-        if(f>threshold) return f;
-        if((stage==2 && state.isSolved())||(stage==1 && h==0)) {
-            found=true;
-            return -1;
-        }
-        TT.insert(state);
-        int min_threshold=INT_MAX;
-        int r=state.empty/sz, c=state.empty%sz;
-        for(int d=0;d<4;++d) {
-            int nr=r+dir4[d][0], nc=c+dir4[d][1];
-            if(nr<0||nr>=sz||nc<0||nc>=sz) continue;
-            int ni=nr*sz+nc;
-            if(locked.count(ni)) continue;
-            if(prev_empty==ni) continue;
-            PuzzleState nxt=state;
-            std::swap(nxt.tiles[state.empty],nxt.tiles[ni]);
-            nxt.empty=ni;
-            bool symm=false;
-            auto syms=all_symmetries(nxt.tiles,sz);
-            for(const auto& s:syms) if(TT.exists(PuzzleState(s,sz))) symm=true;
-            if(symm) continue;
-            path.push_back(nxt.tiles[state.empty]);
-            int t=dfs(nxt,g+1,state.empty);
-            if(found) return -1;
-            if(t<min_threshold) min_threshold=t;
-            path.pop_back();
-        }
-        return min_threshold;
+// --- Pattern database files ---
+// A table is written once and memory-mapped read-only afterwards, so a cold
+// process starts solving without a rebuild and every worker process shares one
+// copy in the page cache. Layout (host byte order, little-endian on every
+// target we build for): a fixed PDBFileHeader, then the encoded table bytes
+// exactly as PatternDB holds them in memory.
+static constexpr char PDB_FILE_MAGIC[8]={'S','L','I','D','E','P','D','B'};
+static constexpr uint32_t PDB_FILE_VERSION=1;
+static constexpr int PDB_FILE_MAX_TILES=32;
+
+struct PDBFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes;          // payload starts here
+    uint8_t rows, cols, encoding, tile_count;
+    uint32_t block;
+    uint64_t entries;
+    uint64_t payload_bytes;
+    uint64_t payload_checksum;
+    uint8_t tiles[PDB_FILE_MAX_TILES];
+    uint64_t header_checksum;       // over every field above
+};
+static_assert(sizeof(PDBFileHeader)==88,"the header layout is part of the file format");
+
+// FNV-1a over 64-bit words (then the tail bytes); fast enough to verify a
+// 100MB table in well under a second.
+inline uint64_t checksum64(const uint8_t* p,size_t n) {
+    uint64_t h=1469598103934665603ull;
+    size_t i=0;
+    for(;i+8<=n;i+=8) {
+        uint64_t w;
+        std::memcpy(&w,p+i,8);
+        h=(h^w)*1099511628211ull;
+    }
+    for(;i<n;++i) h=(h^p[i])*1099511628211ull;
+    return h;
+}
+inline uint64_t header_checksum(const PDBFileHeader& h) {
+    return checksum64(reinterpret_cast<const uint8_t*>(&h),offsetof(PDBFileHeader,header_checksum));
+}
+
+// Read-only table bytes, owned or mapped from a file. PatternDB copies share
+// one instance; a mapping is released with the last of them.
+class TableBytes {
+public:
+    explicit TableBytes(std::vector<uint8_t>&& v): owned(std::move(v)), map(nullptr), map_len(0), base(owned.data()), len(owned.size()) {}
+    TableBytes(void* m,size_t m_len,size_t offset,size_t n): map(m), map_len(m_len), base((const uint8_t*)m+offset), len(n) {}
+    ~TableBytes() { if(map) munmap(map,map_len); }
+    TableBytes(const TableBytes&)=delete;
+    TableBytes& operator=(const TableBytes&)=delete;
+    const uint8_t* data() const { return base; }
+    size_t size() const { return len; }
+    bool mapped() const { return map!=nullptr; }
+
+    // Maps a whole file read-only; nullptr (with len 0) on failure.
+    static void* map_file(const std::string& path,size_t& len) {
+        len=0;
+        int fd=open(path.c_str(),O_RDONLY);
+        if(fd<0) return nullptr;
+        struct stat st;
+        void* m=nullptr;
+        if(fstat(fd,&st)==0 && st.st_size>0) {
+            m=mmap(nullptr,(size_t)st.st_size,PROT_READ,MAP_SHARED,fd,0);
+            if(m==MAP_FAILED) m=nullptr;
+            else len=(size_t)st.st_size;
+        }
+        close(fd);
+#ifdef MADV_RANDOM
+        if(m) madvise(m,len,MADV_RANDOM); // lookups hit random pages; skip read-ahead
+#endif
+        return m;
+    }
+
+private:
+    std::vector<uint8_t> owned;
+    void* map;
+    size_t map_len;
+    const uint8_t* base;
+    size_t len;
+};
+
+// Directory the solvers load tables from and save freshly built ones to;
+// empty disables persistence.
+inline std::string pdb_directory;
+
+// Checks a table file's header and payload checksum without knowing its
+// pattern. Returns "" when intact, otherwise the reason.
+inline std::string check_pdb_file(const std::string& path,PDBFileHeader* out=nullptr) {
+    size_t len;
+    void* m=TableBytes::map_file(path,len);
+    if(!m) return "cannot map "+path;
+    PDBFileHeader h;
+    std::string err;
+    if(len<sizeof h) err="truncated header";
+    else {
+        std::memcpy(&h,m,sizeof h);
+        if(std::memcmp(h.magic,PDB_FILE_MAGIC,8)) err="bad magic";
+        else if(h.version!=PDB_FILE_VERSION) err="version "+std::to_string(h.version);
+        else if(h.header_checksum!=header_checksum(h)) err="header checksum mismatch";
+        else if(h.header_bytes+h.payload_bytes!=len) err="size mismatch";
+        else if(checksum64((const uint8_t*)m+h.header_bytes,h.payload_bytes)!=h.payload_checksum) err="payload checksum mismatch";
+        else if(out) *out=h;
+    }
+    munmap(m,len);
+    return err;
+}
+
+// --- Pattern Database (flat, rank-indexed) ---
+// A pattern is a list of tiles, where 0 stands for the blank. The cells they
+// occupy form an ordered k-permutation of the board, which rank() maps to a
+// dense index in [0, N!/(N-k)!) with a mixed-radix Lehmer code: a lookup is k
+// popcounts and multiply-adds plus one read from a flat table.
+// Without the blank the abstraction is additive: only moves of pattern tiles
+// are counted, so lookups in disjoint patterns can be summed.
+//
+// Storage encodings trade lookup work for memory:
+//   PDB_BYTE    one byte per entry.
+//   PDB_NIBBLE  4 bits: the excess over the pattern tiles' Manhattan distance
+//               (halved when additive, where it is always even), saturating
+//               at 15 so a lookup never overestimates.
+//   PDB_MOD3    2 bits: h mod 3. A move changes h by at most one, so a child's
+//               value follows from its parent's; a root's is found by walking
+//               down to the goal.
+// A block size above 1 keeps only the minimum of each run of that many
+// consecutive ranks (same leading tiles, nearby last tile): lossy but still
+// admissible. MOD3 needs exact values and ignores it.
+enum PDBEncoding { PDB_BYTE, PDB_NIBBLE, PDB_MOD3 };
+
+template<int R,int C>
+class PatternDB {
+public:
+    typedef PuzzleState<R,C> State;
+    typedef MoveTable<R,C> Moves;
+    static constexpr int N=R*C;
+    static constexpr uint8_t UNSEEN=0xFF;
+
+    PatternDB(): encoding(PDB_BYTE), block(1), entries(0), blank(-1) {}
+    explicit PatternDB(const std::vector<uint8_t>& pattern,PDBEncoding enc=PDB_BYTE,int block_size=1):
+        tiles(pattern), encoding(enc), block(enc==PDB_MOD3?1:std::max(block_size,1)), entries(1), blank(-1) {
+        for(int j=0;j<(int)tiles.size();++j) {
+            entries*=N-j;
+            if(tiles[j]==0) blank=j;
+        }
+    }
+    const std::vector<uint8_t>& pattern() const { return tiles; }
+    size_t size() const { return entries; }
+    size_t memory_bytes() const { return bytes?bytes->size():0; }
+    PDBEncoding storage() const { return encoding; }
+    bool built() const { return table!=nullptr; }
+    bool mapped() const { return bytes && bytes->mapped(); }
+    bool additive() const { return blank<0; }
+
+    size_t rank(const uint8_t* cells) const {
+        uint32_t used=0;
+        size_t idx=0;
+        for(int j=0;j<(int)tiles.size();++j) {
+            int c=cells[j];
+            idx=idx*(N-j)+(c-__builtin_popcount(used&((1u<<c)-1)));
+            used|=1u<<c;
+        }
+        return idx;
+    }
+    void unrank(size_t idx,uint8_t* cells) const {
+        int k=tiles.size(), digit[N];
+        for(int j=k-1;j>=0;--j) { digit[j]=idx%(N-j); idx/=N-j; }
+        uint32_t used=0;
+        for(int j=0;j<k;++j) {
+            int c=-1;
+            for(int d=digit[j];d>=0;--d) do ++c; while(used>>c&1);
+            cells[j]=c;
+            used|=1u<<c;
+        }
+    }
+    size_t rank(const State& s) const {
+        uint8_t cells[N];
+        for(int j=0;j<(int)tiles.size();++j) cells[j]=s.pos[tiles[j]];
+        return rank(cells);
+    }
+    // parent is this table's value for the state one move earlier, or -1 when
+    // unknown; only MOD3 needs it.
+    int lookup(const State& s,int parent=-1) const {
+        uint8_t cells[N];
+        for(int j=0;j<(int)tiles.size();++j) cells[j]=s.pos[tiles[j]];
+        return value(cells,parent);
+    }
+    // Same table, read for the state's mirror image (square boards only).
+    int lookup_reflected(const State& s,int parent=-1) const {
+        typedef Reflection<R,C> M;
+        uint8_t cells[N];
+        for(int j=0;j<(int)tiles.size();++j) cells[j]=M::cell[s.pos[M::tile[tiles[j]]]];
+        return value(cells,parent);
+    }
+
+    // Level-synchronous breadth-first search backwards from the goal over
+    // ranks, split across `threads` workers (0: one per hardware thread). The
+    // seen set and both frontiers are atomic bit vectors; whichever worker
+    // sets a rank's seen bit owns it, so each rank's depth byte has exactly
+    // one writer. The bytes are then re-encoded into the table's storage.
+    void build(int threads=0) {
+        typedef std::vector<std::atomic<uint64_t>> Bits;
+        threads=worker_count(threads);
+        size_t words=(entries+63)/64;
+        std::vector<uint8_t> depth_of(entries,UNSEEN);
+        Bits seen(words), frontier(words), next(words);
+        uint8_t goal[N];
+        goal_cells(goal);
+        size_t g=rank(goal);
+        seen[g>>6]=frontier[g>>6]=1ull<<(g&63);
+        depth_of[g]=0;
+        for(int depth=0;;++depth) {
+            std::atomic<size_t> found(0);
+            parallel_for(words,threads,4096,[&](size_t begin,size_t end) {
+                uint8_t cells[N];
+                size_t local=0;
+                for(size_t w=begin;w<end;++w) {
+                    for(uint64_t bits=frontier[w].load(std::memory_order_relaxed);bits;bits&=bits-1) {
+                        unrank(w*64+__builtin_ctzll(bits),cells);
+                        expand(cells,[&]() {
+                            size_t r=rank(cells);
+                            uint64_t bit=1ull<<(r&63);
+                            if(seen[r>>6].load(std::memory_order_relaxed)&bit) return;
+                            if(seen[r>>6].fetch_or(bit,std::memory_order_relaxed)&bit) return;
+                            next[r>>6].fetch_or(bit,std::memory_order_relaxed);
+                            depth_of[r]=depth+1;
+                            ++local;
+                        });
+                    }
+                }
+                found+=local;
+            });
+            if(!found) break;
+            frontier.swap(next);
+            parallel_for(words,threads,1<<16,[&](size_t begin,size_t end) {
+                for(size_t w=begin;w<end;++w) next[w].store(0,std::memory_order_relaxed);
+            });
+        }
+        encode(depth_of,threads);
+    }
+
+    // --- Files ---
+    // Canonical file name for this table's shape, pattern and storage.
+    std::string file_name() const {
+        static const char* const names[]={"byte","nibble","mod3"};
+        std::string name=std::to_string(R)+"x"+std::to_string(C)+"-";
+        for(size_t j=0;j<tiles.size();++j) name+=(j?".":"")+std::to_string(tiles[j]);
+        name+=std::string("-")+names[encoding];
+        if(block>1) name+="-min"+std::to_string(block);
+        return name+".pdb";
+    }
+    // Writes the built table; a temporary file renamed into place keeps
+    // concurrent readers from ever seeing a partial file.
+    bool save(const std::string& path) const {
+        if(!built()) return false;
+        PDBFileHeader h=header();
+        std::string tmp=path+".tmp"+std::to_string(getpid());
+        std::ofstream out(tmp,std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&h),sizeof h);
+        out.write(reinterpret_cast<const char*>(table),bytes->size());
+        out.close();
+        if(!out || std::rename(tmp.c_str(),path.c_str())!=0) {
+            std::remove(tmp.c_str());
+            DEBUG_LOG(1,"PDB save failed: "+path);
+            return false;
+        }
+        return true;
+    }
+    // Maps a saved table read-only. The header must describe exactly this
+    // table; the payload checksum costs a pass over the file, so it is only
+    // verified on request (the solver's background loads always ask).
+    bool load(const std::string& path,bool verify_payload=false) {
+        size_t len;
+        void* m=TableBytes::map_file(path,len);
+        if(!m) return false;
+        PDBFileHeader h, want=header_for(payload_size(),0);
+        std::string err;
+        if(len<sizeof h) err="truncated header";
+        else {
+            std::memcpy(&h,m,sizeof h);
+            want.payload_checksum=h.payload_checksum;
+            want.header_checksum=header_checksum(want);
+            if(std::memcmp(&h,&want,sizeof h)) err="header does not match the table";
+            else if(len!=h.header_bytes+h.payload_bytes) err="size mismatch";
+            else if(verify_payload && checksum64((const uint8_t*)m+h.header_bytes,h.payload_bytes)!=h.payload_checksum) err="payload checksum mismatch";
+        }
+        if(!err.empty()) {
+            munmap(m,len);
+            DEBUG_LOG(1,"PDB load rejected "+path+": "+err);
+            return false;
+        }
+        adopt(std::make_shared<TableBytes>(m,len,h.header_bytes,h.payload_bytes));
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> tiles;
+    PDBEncoding encoding;
+    int block;
+    size_t entries;
+    int blank;
+    std::shared_ptr<const TableBytes> bytes;
+    const uint8_t* table=nullptr;
+
+    void adopt(std::shared_ptr<const TableBytes> b) {
+        bytes=std::move(b);
+        table=bytes->data();
+    }
+    size_t payload_size() const {
+        size_t slots=(entries+block-1)/block;
+        if(encoding==PDB_MOD3) return (entries+3)/4;
+        return encoding==PDB_NIBBLE?(slots+1)/2:slots;
+    }
+    PDBFileHeader header_for(size_t payload,uint64_t checksum) const {
+        PDBFileHeader h;
+        std::memset(&h,0,sizeof h);
+        std::memcpy(h.magic,PDB_FILE_MAGIC,8);
+        h.version=PDB_FILE_VERSION;
+        h.header_bytes=sizeof h;
+        h.rows=R; h.cols=C; h.encoding=encoding; h.tile_count=tiles.size();
+        h.block=block;
+        h.entries=entries;
+        h.payload_bytes=payload;
+        h.payload_checksum=checksum;
+        std::copy(tiles.begin(),tiles.end(),h.tiles);
+        h.header_checksum=header_checksum(h);
+        return h;
+    }
+    PDBFileHeader header() const { return header_for(bytes->size(),checksum64(table,bytes->size())); }
+
+    void goal_cells(uint8_t* cells) const {
+        for(int j=0;j<(int)tiles.size();++j) cells[j]=tiles[j]?tiles[j]-1:N-1;
+    }
+    int manhattan(const uint8_t* cells) const {
+        int md=0;
+        for(int j=0;j<(int)tiles.size();++j) if(tiles[j]) md+=ManhattanTable<R,C>::dist[tiles[j]][cells[j]];
+        return md;
+    }
+
+    // Calls f() with cells set to each neighbouring abstract state, restoring
+    // them afterwards. Additive patterns move one pattern tile into any free
+    // neighbouring cell; patterns that include the blank move the blank,
+    // dragging a pattern tile with it.
+    template<typename F>
+    void expand(uint8_t* cells,F&& f) const {
+        int k=tiles.size();
+        if(blank<0) {
+            uint32_t occupied=0;
+            for(int j=0;j<k;++j) occupied|=1u<<cells[j];
+            for(int j=0;j<k;++j) {
+                int from=cells[j];
+                const auto& cell=Moves::cells[from];
+                for(int m=0;m<cell.count;++m) {
+                    int to=cell.moves[m].to;
+                    if(occupied>>to&1) continue;
+                    cells[j]=to; f(); cells[j]=from;
+                }
+            }
+            return;
+        }
+        int owner[N];
+        std::fill(owner,owner+N,-1);
+        for(int j=0;j<k;++j) owner[cells[j]]=j;
+        int b=cells[blank];
+        const auto& cell=Moves::cells[b];
+        for(int m=0;m<cell.count;++m) {
+            int to=cell.moves[m].to, j=owner[to];
+            cells[blank]=to;
+            if(j>=0) cells[j]=b;
+            f();
+            cells[blank]=b;
+            if(j>=0) cells[j]=to;
+        }
+    }
+
+    int stored(size_t r) const {
+        if(encoding==PDB_MOD3) return table[r>>2]>>(r&3)*2&3;
+        r/=block;
+        if(encoding==PDB_NIBBLE) return table[r>>1]>>(r&1)*4&15;
+        return table[r];
+    }
+    int value(uint8_t* cells,int parent) const {
+        size_t r=rank(cells);
+        if(encoding==PDB_BYTE) return stored(r);
+        if(encoding==PDB_NIBBLE) return manhattan(cells)+(stored(r)<<additive());
+        int m=stored(r);
+        if(parent<0) return descend(cells,r,m);
+        return parent+(m-parent%3+4)%3-1; // the value within one of parent
+    }
+    // MOD3 value with no parent: step to a neighbour whose residue is one
+    // lower, i.e. one level closer to the goal, until the goal is reached.
+    // A table that offers no such step (or walks longer than any depth the
+    // build can store) is corrupt, and the Manhattan bound stands in.
+    int descend(uint8_t* cells,size_t r,int m) const {
+        int k=tiles.size(), h=0;
+        uint8_t goal[N], closer[N], start[N];
+        goal_cells(goal);
+        std::copy(cells,cells+k,start);
+        size_t goal_rank=rank(goal);
+        while(r!=goal_rank) {
+            int want=(m+2)%3;
+            bool found=false;
+            expand(cells,[&](){
+                if(found) return;
+                size_t q=rank(cells);
+                if(stored(q)!=want) return;
+                found=true; r=q;
+                std::copy(cells,cells+k,closer);
+            });
+            if(!found || h>=UNSEEN) {
+                std::copy(start,start+k,cells);
+                return manhattan(cells);
+            }
+            std::copy(closer,closer+k,cells);
+            m=want; ++h;
+        }
+        return h;
+    }
+
+    // Re-encodes a byte per entry (overwritten in place) into the storage.
+    // Every pass writes disjoint bytes per chunk, so it splits across workers.
+    void encode(std::vector<uint8_t>& raw,int threads) {
+        const size_t CHUNK=1<<16;
+        std::vector<uint8_t> out;
+        if(encoding==PDB_MOD3) {
+            out.assign(payload_size(),0);
+            parallel_for(out.size(),threads,CHUNK,[&](size_t begin,size_t end) {
+                for(size_t i=begin;i<end;++i) for(size_t r=i*4;r<std::min(entries,i*4+4);++r)
+                    out[i]|=raw[r]%3<<(r&3)*2;
+            });
+            adopt(std::make_shared<TableBytes>(std::move(out)));
+            return;
+        }
+        if(encoding==PDB_NIBBLE) {
+            parallel_for(entries,threads,CHUNK,[&](size_t begin,size_t end) {
+                uint8_t cells[N];
+                for(size_t r=begin;r<end;++r) {
+                    unrank(r,cells);
+                    raw[r]=std::min((raw[r]-manhattan(cells))>>additive(),15);
+                }
+            });
+        }
+        if(block>1) {
+            std::vector<uint8_t> low((entries+block-1)/block);
+            parallel_for(low.size(),threads,CHUNK,[&](size_t begin,size_t end) {
+                for(size_t i=begin;i<end;++i)
+                    low[i]=*std::min_element(raw.begin()+i*block,raw.begin()+std::min(entries,(i+1)*block));
+            });
+            raw.swap(low);
+        }
+        if(encoding==PDB_BYTE) out.swap(raw);
+        else {
+            out.assign(payload_size(),0);
+            parallel_for(out.size(),threads,CHUNK,[&](size_t begin,size_t end) {
+                for(size_t i=begin;i<end;++i) for(size_t j=i*2;j<std::min(raw.size(),i*2+2);++j)
+                    out[i]|=raw[j]<<(j&1)*4;
+            });
+        }
+        adopt(std::make_shared<TableBytes>(std::move(out)));
+    }
+};
+
+// --- Background table loading ---
+// A build run once on a background thread the first time anyone asks for it,
+// which callers poll or wait for instead of blocking on the build itself.
+class BackgroundBuild {
+public:
+    typedef std::function<void()> Build;
+    enum Status { ABSENT=0, LOADING=1, READY=2 };
+
+    explicit BackgroundBuild(Build b): build(std::move(b)), state(ABSENT) {}
+
+    Status status() const { return (Status)state.load(); }
+    // Starts the build unless already started; never blocks, except where
+    // threads are unavailable (single-threaded WASM) and it builds inline.
+    void request() {
+        int expected=ABSENT;
+        if(!state.compare_exchange_strong(expected,LOADING)) return;
+        try { std::thread([this]() { run(); }).detach(); }
+        catch(const std::system_error&) { run(); }
+    }
+    // Whether the build is done, waiting up to wait_ms (requesting it first).
+    bool ready(int wait_ms=0) {
+        request();
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait_for(lock,std::chrono::milliseconds(wait_ms),[&]() { return state.load()!=LOADING; });
+        return state.load()==READY;
+    }
+    // Blocks until the build has finished or failed.
+    bool wait() {
+        request();
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock,[&]() { return state.load()!=LOADING; });
+        return state.load()==READY;
+    }
+
+private:
+    void run() {
+        int result=READY;
+        try { build(); }
+        catch(const std::exception& e) {
+            DEBUG_LOG(1,std::string("Table build failed: ")+e.what());
+            result=ABSENT; // a later request retries
+        }
+        std::lock_guard<std::mutex> lock(mu);
+        state=result;
+        cv.notify_all();
+    }
+
+    Build build;
+    std::atomic<int> state;
+    std::mutex mu;
+    std::condition_variable cv;
+};
+
+// One partition's tables, loaded by a BackgroundBuild. Readers take a shared
+// snapshot: a search keeps the tables it started with, and the next solve
+// picks up a set that became ready meanwhile. Until then optimal solves fall
+// back to table-free heuristics at once, while stage searches wait up to
+// STAGE_TABLE_WAIT_MS (the stage tables build in milliseconds) first.
+template<int R,int C>
+class PDBSet {
+public:
+    typedef std::vector<PatternDB<R,C>> Tables;
+    typedef std::shared_ptr<const Tables> Snapshot;
+    typedef void (*Loader)(Tables&);
+    typedef BackgroundBuild::Status Status;
+
+    explicit PDBSet(Loader l): loader(l), build([this]() { run(); }) {}
+
+    Status status() const { return build.status(); }
+    void request() { build.request(); }
+    // The tables if ready within wait_ms (requesting them first), else null.
+    Snapshot acquire(int wait_ms=0) {
+        build.ready(wait_ms);
+        return snapshot();
+    }
+    // Blocks until the tables are ready; null if loading failed.
+    Snapshot get() {
+        build.wait();
+        return snapshot();
+    }
+
+private:
+    void run() {
+        Tables t;
+        loader(t);
+        std::lock_guard<std::mutex> lock(mu);
+        tables=std::make_shared<const Tables>(std::move(t));
+    }
+    Snapshot snapshot() {
+        std::lock_guard<std::mutex> lock(mu);
+        return tables;
+    }
+
+    Loader loader;
+    std::mutex mu;
+    Snapshot tables;
+    BackgroundBuild build; // last, so it is built after the state run() uses
+};
+
+// --- Placement subgoals ---
+// Exact number of moves to bring one or two tiles home while the blank stays
+// off the locked cells. Only the target tiles and the blank matter (every
+// other tile rides along wherever the blank goes), so a breadth-first search
+// over (tile cells, blank cell) from the placed states is exact: N^2 entries
+// for one tile, N^3 for a pair. Tables are cached per (tiles, lock mask).
+template<int R,int C>
+class PlacementTable {
+public:
+    typedef PuzzleState<R,C> State;
+    typedef MoveTable<R,C> Moves;
+    static constexpr int N=R*C;
+    static constexpr uint8_t UNREACHABLE=0xFF;
+
+    static const PlacementTable& get(const std::vector<uint8_t>& tiles,uint32_t locked) {
+        Cache& c=cache();
+        uint32_t key=0;
+        for(uint8_t v:tiles) key=key<<8|v;
+        std::lock_guard<std::mutex> lock(c.mu);
+        auto& t=c.tables[{key,locked}];
+        if(!t) t.reset(new PlacementTable(tiles,locked));
+        return *t;
+    }
+    // Bytes held by every table built so far.
+    static size_t memory() {
+        Cache& c=cache();
+        std::lock_guard<std::mutex> lock(c.mu);
+        size_t bytes=0;
+        for(const auto& t:c.tables) bytes+=t.second->dist.size();
+        return bytes;
+    }
+    int distance(const State& s) const {
+        uint32_t i=s.empty;
+        for(int k=0;k<count;++k) i=i*N+s.pos[tiles[k]];
+        return dist[i];
+    }
+
+private:
+    struct Cache {
+        std::mutex mu;
+        std::map<std::pair<uint32_t,uint32_t>,std::unique_ptr<const PlacementTable>> tables;
     };
-    while(true) {
+    static Cache& cache() { static Cache c; return c; }
+
+    PlacementTable(const std::vector<uint8_t>& t,uint32_t lk): count((int)t.size()), locked(lk) {
+        for(int k=0;k<count;++k) tiles[k]=t[k];
+        size_t size=N;
+        for(int k=0;k<count;++k) size*=N;
+        dist.assign(size,UNREACHABLE);
+        std::vector<uint32_t> queue;
+        int cells[3];
+        for(int k=0;k<count;++k) cells[k+1]=tiles[k]-1;
+        for(int b=0;b<N;++b) {
+            cells[0]=b;
+            if(valid(cells)) {dist[index(cells)]=0;queue.push_back(index(cells));}
+        }
+        // Moves are reversible, so searching out from the placed states gives
+        // each state's distance to them.
+        for(size_t head=0;head<queue.size();++head) {
+            uint32_t i=queue[head];
+            for(int k=count;k>=0;--k) {cells[k]=i%N;i/=N;}
+            int d=dist[queue[head]];
+            int blank=cells[0];
+            const auto& cell=Moves::cells[blank];
+            for(int m=0;m<cell.count;++m) {
+                int to=cell.moves[m].to;
+                if(locked>>to&1) continue;
+                int next[3]={to,cells[1],cells[2]};
+                for(int k=1;k<=count;++k) if(next[k]==to) next[k]=blank;
+                uint32_t j=index(next);
+                if(dist[j]!=UNREACHABLE) continue;
+                dist[j]=d+1;
+                queue.push_back(j);
+            }
+        }
+    }
+    uint32_t index(const int* cells) const {
+        uint32_t i=0;
+        for(int k=0;k<=count;++k) i=i*N+cells[k];
+        return i;
+    }
+    bool valid(const int* cells) const {
+        for(int k=0;k<=count;++k) {
+            if(locked>>cells[k]&1) return false;
+            for(int j=0;j<k;++j) if(cells[j]==cells[k]) return false;
+        }
+        return true;
+    }
+
+    int count;
+    uint8_t tiles[2];
+    uint32_t locked;
+    std::vector<uint8_t> dist;
+};
+
+// --- Exact region tables ---
+// Exact distance to the goal for every arrangement of the tiles whose homes
+// are the unlocked cells, with the blank confined to those cells (the locked
+// ones must hold their own tiles). A state is ranked by the region slots of
+// the blank and all tiles but the last two: those take the two free slots in
+// the one order parity allows, so an n-cell region has n!/2 ranks, stored a
+// byte each. The 4x4 after stage 1 leaves 10 cells: 1.8M entries.
+template<int R,int C>
+class RegionTable {
+public:
+    typedef PuzzleState<R,C> State;
+    typedef MoveTable<R,C> Moves;
+    static constexpr int N=R*C;
+    static constexpr int MAX_CELLS=12;
+    static constexpr uint8_t UNREACHABLE=0xFF;
+
+    static bool fits(uint32_t locked) {
+        int n=0;
+        for(int c=0;c<N;++c) n+=!(locked>>c&1);
+        return n>=3 && n<=MAX_CELLS && !(locked>>(N-1)&1);
+    }
+    // Built on first use per lock mask; fits(locked) must hold.
+    static const RegionTable& get(uint32_t locked) {
+        Cache& c=cache();
+        std::lock_guard<std::mutex> lock(c.mu);
+        auto& t=c.tables[locked];
+        if(!t) t.reset(new RegionTable(locked));
+        return *t;
+    }
+    // Bytes held by every table built so far (0 while one is building).
+    static size_t memory() {
+        Cache& c=cache();
+        std::unique_lock<std::mutex> lock(c.mu,std::try_to_lock);
+        size_t bytes=0;
+        if(lock) for(const auto& t:c.tables) if(t.second) bytes+=t.second->dist.size();
+        return bytes;
+    }
+    int distance(const State& s) const {
+        int at[MAX_CELLS];
+        for(int k=0;k<n;++k) at[k]=slot[k==0?s.empty:s.pos[tiles[k]]];
+        return dist[rank(at)];
+    }
+    // Walks s to the goal along strictly decreasing distances, appending the
+    // moved tiles; false when s cannot reach it.
+    bool descend(State& s,std::vector<uint8_t>& moves) const {
+        int d=distance(s);
+        if(d==UNREACHABLE) return false;
+        for(;d>0;--d) {
+            const auto& cell=cells[s.empty];
+            for(int k=0;k<cell.count;++k) {
+                int from=s.empty, to=cell.moves[k].to;
+                uint8_t v=s.at(to);
+                s.slide(to);
+                if(distance(s)==d-1) {moves.push_back(v);break;}
+                s.slide(from);
+            }
+        }
+        return true;
+    }
+    size_t size() const { return dist.size(); }
+
+private:
+    struct Cache {
+        std::mutex mu;
+        std::map<uint32_t,std::unique_ptr<const RegionTable>> tables;
+    };
+    static Cache& cache() { static Cache c; return c; }
+
+    // Item 0 is the blank, item k>0 the tile at home in slot k-1; the blank's
+    // home is the last slot.
+    explicit RegionTable(uint32_t locked): cells(Moves::open(locked)), n(0) {
+        for(int c=0;c<N;++c) {
+            slot[c]=locked>>c&1?-1:n;
+            if(slot[c]>=0) cell[n++]=c;
+        }
+        tiles[0]=0;
+        for(int k=1;k<n;++k) tiles[k]=cell[k-1]+1;
+        uint32_t size=1;
+        for(int k=n;k>2;--k) size*=k;
+        dist.assign(size,UNREACHABLE);
+        int at[MAX_CELLS], goal[MAX_CELLS];
+        goal[0]=n-1;
+        for(int k=1;k<n;++k) goal[k]=k-1;
+        std::vector<uint32_t> queue{rank(goal)};
+        dist[queue[0]]=0;
+        // Moves are reversible, so searching out from the goal gives each
+        // state's distance to it.
+        for(size_t head=0;head<queue.size();++head) {
+            unrank(queue[head],at);
+            int d=dist[queue[head]], blank=at[0];
+            int item[MAX_CELLS];
+            for(int k=0;k<n;++k) item[at[k]]=k;
+            const auto& moves=cells[cell[blank]];
+            for(int m=0;m<moves.count;++m) {
+                int to=slot[moves.moves[m].to];
+                std::swap(at[0],at[item[to]]);
+                uint32_t j=rank(at);
+                std::swap(at[0],at[item[to]]);
+                if(dist[j]!=UNREACHABLE) continue;
+                dist[j]=d+1;
+                queue.push_back(j);
+            }
+        }
+        DEBUG_LOG(2,"Region table: "+std::to_string(size)+" entries, depth "+std::to_string(dist[queue.back()]));
+    }
+    // Mixed radix n, n-1, ..., 3 over the first n-2 items' slots, each digit
+    // counting the free slots below.
+    uint32_t rank(const int* at) const {
+        uint32_t r=0, used=0;
+        for(int k=0;k<n-2;++k) {
+            r=r*(n-k)+at[k]-__builtin_popcount(used&((1u<<at[k])-1));
+            used|=1u<<at[k];
+        }
+        return r;
+    }
+    void unrank(uint32_t r,int* at) const {
+        int digit[MAX_CELLS];
+        for(int k=n-3;k>=0;--k) {digit[k]=r%(n-k);r/=n-k;}
+        uint32_t used=0;
+        for(int k=0;k<n-2;++k) {
+            int sl=0;
+            for(int left=digit[k];;++sl) if(!(used>>sl&1) && left--==0) break;
+            at[k]=sl;
+            used|=1u<<sl;
+        }
+        at[n-2]=__builtin_ctz(~used);
+        used|=1u<<at[n-2];
+        at[n-1]=__builtin_ctz(~used);
+        // Each move swaps the blank with a tile and changes the colour of the
+        // blank's cell, so the permutation's parity tracks that colour.
+        int inversions=0;
+        for(int a=0;a<n;++a) for(int b=a+1;b<n;++b) inversions+=at[a]>at[b];
+        int c=cell[at[0]], home=cell[n-1];
+        if((inversions+n-1+(c/C+c%C)+(home/C+home%C))&1) std::swap(at[n-2],at[n-1]);
+    }
+
+    std::array<typename Moves::Cell,N> cells; // moves within the region
+    int n;
+    int slot[N];          // region slot of each cell, -1 when locked
+    int cell[MAX_CELLS];  // cell of each slot
+    uint8_t tiles[MAX_CELLS];
+    std::vector<uint8_t> dist;
+};
+
+// --- Heuristic composition ---
+// Admissible sources that the searches combine with MaxHeuristic. A source
+// keeps its own incremental state per search node:
+//   Lines of(const State&) const
+//   void update(Lines&,const State&,int v,int from,int to) const   tile v moved
+// with Lines exposing int h() const. LinearConflict and WalkingDistance follow
+// the same shape.
+
+// Manhattan distance over the tiles in a mask.
+template<int R,int C>
+struct ManhattanSum {
+    struct Lines { int16_t md; int h() const { return md; } };
+    uint32_t mask;
+    explicit ManhattanSum(uint32_t tile_mask=~0u): mask(tile_mask&~1u) {}
+    Lines of(const PuzzleState<R,C>& s) const {
+        Lines l{};
+        for(int v=1;v<R*C;++v) if(mask>>v&1) l.md+=ManhattanTable<R,C>::dist[v][s.pos[v]];
+        return l;
+    }
+    void update(Lines& l,const PuzzleState<R,C>&,int v,int from,int to) const {
+        if(mask>>v&1) l.md+=ManhattanTable<R,C>::delta(v,from,to);
+    }
+};
+
+// Sum over disjoint additive PDBs, read for the state or for its mirror image.
+// A move changes only the group holding the moved tile (for the mirror, the
+// group holding its image), so an update is one lookup.
+template<int R,int C>
+class PDBSum {
+public:
+    typedef PatternDB<R,C> PDB;
+    static constexpr int MAX_GROUPS=8;
+    static constexpr uint8_t NONE=0xFF;
+    struct Lines { uint8_t part[MAX_GROUPS]; int16_t sum; int h() const { return sum; } };
+
+    explicit PDBSum(const std::vector<PDB>& p,bool mirror=false): pdb(&p), mirrored(mirror) {
+        assert(p.size()<=MAX_GROUPS);
+        std::fill(group,group+R*C,NONE);
+        for(size_t g=0;g<p.size();++g) for(uint8_t v:p[g].pattern()) {
+            assert(v!=0);
+            group[v]=g;
+        }
+        if constexpr(R==C) if(mirrored) {
+            uint8_t direct[R*C];
+            std::copy(group,group+R*C,direct);
+            for(int v=1;v<R*C;++v) group[v]=direct[Reflection<R,C>::tile[v]];
+        }
+    }
+    Lines of(const PuzzleState<R,C>& s) const {
+        Lines l{};
+        for(size_t g=0;g<pdb->size();++g) {
+            l.part[g]=read(g,s,-1);
+            l.sum+=l.part[g];
+        }
+        return l;
+    }
+    void update(Lines& l,const PuzzleState<R,C>& s,int v,int,int) const {
+        int g=group[v];
+        if(g==NONE) return;
+        int h=read(g,s,l.part[g]);
+        l.sum+=h-l.part[g];
+        l.part[g]=h;
+    }
+
+private:
+    const std::vector<PDB>* pdb;
+    bool mirrored;
+    uint8_t group[R*C];
+    int read(int g,const PuzzleState<R,C>& s,int parent) const {
+        if constexpr(R==C) if(mirrored) return (*pdb)[g].lookup_reflected(s,parent);
+        return (*pdb)[g].lookup(s,parent);
+    }
+};
+
+// h is the max over the enabled sources, listed cheapest first. child() stops
+// at the first source that lifts h above the engine's bound: the child is cut
+// off without being expanded, so the sources it skipped need no update.
+template<typename... Sources>
+struct MaxHeuristic {
+    static constexpr size_t COUNT=sizeof...(Sources);
+    struct Node { int h; std::tuple<typename Sources::Lines...> lines; };
+    std::tuple<Sources...> sources;
+    uint32_t enabled;
+
+    explicit MaxHeuristic(Sources... s,uint32_t on=~0u): sources(s...), enabled(on) {}
+
+    template<typename State>
+    Node root(const State& s) const {
+        Node n{};
+        init<0>(n,s);
+        return n;
+    }
+    template<typename State>
+    Node child(const State& s,const Node& p,int v,int from,int to,int bound) const {
+        Node n=p;
+        n.h=0;
+        step<0>(n,s,v,from,to,bound);
+        return n;
+    }
+
+private:
+    template<size_t I,typename State>
+    void init(Node& n,const State& s) const {
+        if constexpr(I<COUNT) {
+            if(enabled>>I&1) {
+                auto& l=std::get<I>(n.lines);
+                l=std::get<I>(sources).of(s);
+                n.h=std::max(n.h,l.h());
+            }
+            init<I+1>(n,s);
+        }
+    }
+    template<size_t I,typename State>
+    void step(Node& n,const State& s,int v,int from,int to,int bound) const {
+        if constexpr(I<COUNT) {
+            if(enabled>>I&1) {
+                auto& l=std::get<I>(n.lines);
+                std::get<I>(sources).update(l,s,v,from,to);
+                n.h=std::max(n.h,l.h());
+                if(n.h>bound) return;
+            }
+            step<I+1>(n,s,v,from,to,bound);
+        }
+    }
+};
+
+// --- IDA* engine ---
+// Iterative deepening A* over one state that is mutated in place. The
+// depth-first pass runs on an explicit stack of fixed-size frames (next move
+// index, pruning-automaton state, undo cell, heuristic node), so expanding a
+// node costs no call, no board copy and no allocation. The policy supplies:
+//   Node root(const State&)                                  heuristic at the root
+//   Node child(const State&,const Node&,int v,int from,int to,int bound)
+//                                                           after tile v moved
+//   bool is_goal(const State&,const Node&)
+// where Node is any small struct with an int member h. bound is the largest h
+// that keeps the child within the threshold; a policy may stop refining h once
+// it exceeds bound, since such a child is cut off without being expanded.
+template<int R,int C,typename Policy>
+class IDAEngine {
+public:
+    typedef PuzzleState<R,C> State;
+    typedef MoveTable<R,C> Moves;
+    typedef typename Policy::Node Node;
+    static constexpr int MAX_DEPTH=255;
+    enum Status { FOUND, CUTOFF, ABORTED };
+
+    typedef std::chrono::steady_clock Clock;
+    IDAEngine(Policy& p,uint32_t locked): policy(p), cells(Moves::open(locked)), fsm(MoveFSM::get()), stop(nullptr),
+        deadline(Clock::time_point::max()), expired(false), nodes(0), depth(0) {}
+
+    // A pass aborts soon after *flag becomes true or the deadline passes; both
+    // are checked every 1024 nodes, so a pass never overruns by more.
+    void set_stop(const std::atomic<bool>* flag) { stop=flag; }
+    void set_deadline(Clock::time_point t) { deadline=t; }
+    // Whether the last ABORTED pass ran out of time.
+    bool timed_out() const { return expired; }
+
+    // One bounded depth-first pass. FOUND leaves s at the goal with path()
+    // holding the moved tiles; otherwise s is restored to the root and, on
+    // CUTOFF, next is the smallest f that exceeded the threshold.
+    Status iterate(State& s,int threshold,int& next,long node_limit) {
+        return search(s,policy.root(s),0,threshold,next,node_limit);
+    }
+    // The same pass over the subtree below s, whose heuristic node and
+    // pruning-automaton state are given; depths and f count from s.
+    Status search(State& s,const Node& root,int q,int threshold,int& next,long node_limit) {
+        next=INT_MAX;
         nodes=0;
-        TT.clear();
-        int r=dfs(start,0,-1);
-        if(found) break;
-        if(r==INT_MAX || nodes>node_limit) {fail_reason="search_limit";break;}
-        threshold=r;
-        auto now=std::chrono::high_resolution_clock::now();
-        if(std::chrono::duration_cast<std::chrono::milliseconds>(now-start_time).count()>time_limit_ms) {fail_reason="timeout";break;}
-    }
-    return {path,found,nodes,(int)path.size(),fail_reason};
-}
+        depth=0;
+        expired=false;
+        stack[0]={root,-1,(int16_t)q,0};
+        while(depth>=0) {
+            Frame& f=stack[depth];
+            if(f.next<0) {
+                if(++nodes>node_limit || ((nodes&1023)==0 && interrupted())) {
+                    unwind(s);
+                    return ABORTED;
+                }
+                int fv=depth+f.node.h;
+                if(fv>threshold) {
+                    if(fv<next) next=fv;
+                    pop(s);
+                    continue;
+                }
+                if(policy.is_goal(s,f.node)) return FOUND;
+                f.next=0;
+            }
+            const auto& cell=cells[s.empty];
+            bool descended=false;
+            while(f.next<cell.count && depth<MAX_DEPTH) {
+                auto mv=cell.moves[f.next++];
+                int q=fsm.next(f.fsm,mv.dir);
+                if(q<0) continue;
+                int from=s.empty;
+                uint8_t v=s.at(mv.to);
+                s.slide(mv.to);
+                moves[depth]=v;
+                stack[depth+1]={policy.child(s,f.node,v,mv.to,from,threshold-depth-1),-1,(int16_t)q,(uint8_t)from};
+                ++depth;
+                descended=true;
+                break;
+            }
+            if(!descended) pop(s);
+        }
+        return CUTOFF;
+    }
+    const uint8_t* path() const { return moves; }
+    int length() const { return depth; }
+    long node_count() const { return nodes; }
 
-// --- Bidirectional BFS ---
-struct BiBFSResult {
+private:
+    struct Frame { Node node; int8_t next; int16_t fsm; uint8_t undo; };
+    void pop(State& s) {
+        if(depth>0) s.slide(stack[depth].undo);
+        --depth;
+    }
+    void unwind(State& s) { while(depth>0) pop(s); }
+    bool interrupted() {
+        if(stop && stop->load(std::memory_order_relaxed)) return true;
+        return expired=deadline!=Clock::time_point::max() && Clock::now()>deadline;
+    }
+
+    Policy& policy;
+    std::array<typename Moves::Cell,R*C> cells; // moves off the locked cells
+    const MoveFSM& fsm;
+    const std::atomic<bool>* stop;
+    Clock::time_point deadline;
+    bool expired;
+    long nodes;
+    int depth;
+    Frame stack[MAX_DEPTH+1];
+    uint8_t moves[MAX_DEPTH];
+};
+
+// --- Search results ---
+struct IDAResult {
     std::vector<uint8_t> moves;
     bool success;
     int nodes;
     int length;
     std::string fail_reason;
 };
-BiBFSResult bibfs(const PuzzleState& start,int sz,int max_depth,int stage=2,int node_limit=200000,const std::set<int>& locked={}) {
-    PuzzleState goal(sz);
-    for(int i=0;i<sz*sz-1;i++) goal.tiles[i]=i+1;
-    goal.tiles[sz*sz-1]=0;
-    goal.empty=sz*sz-1;
-    std::queue<std::pair<PuzzleState,std::vector<uint8_t>>> Q;
-    std::unordered_set<PuzzleState,PuzzleHash> Vis;
-    Q.push({start,{}});
-    Vis.insert(start);
-    int nodes=0;
-    while(!Q.empty() && nodes<node_limit) {
-        auto [state,moves]=Q.front(); Q.pop();
-        nodes++;
-        int r=state.empty/sz, c=state.empty%sz;
-        if(state==goal) return {moves,true,nodes,(int)moves.size(),""};
-        if((int)moves.size()>=max_depth) continue;
-        for(int d=0;d<4;++d) {
-            int nr=r+dir4[d][0], nc=c+dir4[d][1];
-            if(nr<0||nr>=sz||nc<0||nc>=sz) continue;
-            int ni=nr*sz+nc;
-            if(locked.count(ni)) continue;
-            PuzzleState nxt=state;
-            std::swap(nxt.tiles[state.empty],nxt.tiles[ni]);
-            nxt.empty=ni;
-            if(Vis.count(nxt)) continue;
-            Vis.insert(nxt);
-            auto nmoves=moves;
-            nmoves.push_back(nxt.tiles[state.empty]);
-            Q.push({nxt,nmoves});
-        }
-    }
-    return {{},false,nodes,0,"failed"};
-}
-
-// --- Multi-threaded search (for large puzzles) ---
-struct ThreadResult {
+struct BiBFSResult {
     std::vector<uint8_t> moves;
     bool success;
     int nodes;
     int length;
     std::string fail_reason;
 };
-ThreadResult thread_ida_search(const PuzzleState& start,int sz,int max_depth,int stage,int node_limit,int time_limit_ms,const std::set<int>& locked) {
-    auto res=ida_star(start,sz,max_depth,stage,node_limit,time_limit_ms,locked);
-    return {res.moves,res.success,res.nodes,res.length,res.fail_reason};
-}
 
-// --- Move Application ---
-void apply_moves(PuzzleState& state,const std::vector<uint8_t>& moves) {
-    int sz=state.size;
-    for(auto mv:moves) {
-        int from=-1;
-        for(int j=0;j<sz*sz;j++) if(state.tiles[j]==mv) from=j;
-        std::swap(state.tiles[state.empty],state.tiles[from]);
-        state.empty=from;
+// Heuristic sources the staged IDA* can take the max over.
+enum Heuristic { H_PDB=1, H_LINEAR_CONFLICT=2, H_WALKING_DISTANCE=4 };
+
+// --- Solver, specialised per board size ---
+// Everything that depends on the board dimensions lives here, so each size gets
+// its own pattern databases and its own fully unrolled search routines.
+// solve_puzzle() dispatches once on the runtime size and never again.
+template<int R,int C>
+struct Solver {
+    typedef PuzzleState<R,C> State;
+    typedef MoveTable<R,C> Moves;
+    typedef PatternDB<R,C> PDB;
+    static constexpr int N=R*C;
+    static constexpr int STAGE1_TILES=N<=16?6:12;
+
+    // --- Pattern Databases (additive groups of flat tables) ---
+    typedef PDBSet<R,C> Tables;
+    typedef typename Tables::Snapshot Snapshot;
+
+    // Disjoint groups of three covering the tiles a stage places (1..STAGE1_TILES
+    // for stage 1, the rest for stage 2): each table has N*(N-1)*(N-2)
+    // entries, small enough to build on the first solve.
+    static std::vector<std::vector<uint8_t>> stage_partition(int stage) {
+        int first=stage==1?1:STAGE1_TILES+1, last=stage==1?STAGE1_TILES:N-1;
+        std::vector<std::vector<uint8_t>> groups;
+        for(int v=first;v<=last;v+=3) {
+            groups.emplace_back();
+            for(int t=v;t<=std::min(v+2,last);++t) groups.back().push_back(t);
+        }
+        return groups;
+    }
+
+    // --- Optimal mode: additive disjoint PDBs over the whole board ---
+    // 4x4 uses Korf's 7-8 split (tiles 1-7 and 8-15): 57.6M + 518.9M entries.
+    // 5x5 uses the Korf-Felner 6-6-6-6 partition rotated onto our bottom-right
+    // blank: four 127.5M-entry tables. Both are built once on the first optimal
+    // solve and stored mod 3 (144MB and 128MB); the reflected lookups supply
+    // the mirror partition.
+    static std::vector<std::vector<uint8_t>> optimal_partition() {
+        std::vector<std::vector<uint8_t>> groups;
+        if(N==16) {
+            groups.resize(2);
+            for(int v=1;v<N;++v) groups[v<=7?0:1].push_back(v);
+        } else if(N==25) {
+            groups={{1,2,3,6,7,8},{4,5,9,10,14,15},{11,12,16,17,21,22},{13,18,19,20,23,24}};
+        }
+        return groups;
+    }
+
+    static constexpr PDBEncoding OPTIMAL_ENCODING=PDB_MOD3;
+    // Maps each table from pdb_directory when a matching file is there and
+    // its payload checksum holds; otherwise builds it and saves it for the
+    // next process. This runs on the PDBSet thread, so the check costs a
+    // request nothing.
+    static void build_pdb(const std::vector<std::vector<uint8_t>>& partition,std::vector<PDB>& pdb,PDBEncoding enc=PDB_BYTE,int block=1) {
+        pdb.clear();
+        for(const auto& p:partition) {
+            pdb.emplace_back(p,enc,block);
+            PDB& db=pdb.back();
+            std::string path=pdb_directory.empty()?"":pdb_directory+"/"+db.file_name();
+            if(!path.empty() && db.load(path,true)) {
+                DEBUG_LOG(2,"PDB "+vec2str(p)+": mapped "+path);
+                continue;
+            }
+            db.build();
+            DEBUG_LOG(2,"PDB "+vec2str(p)+": "+std::to_string(db.size())+" entries, "+std::to_string(db.memory_bytes())+" bytes");
+            if(!path.empty()) db.save(path);
+        }
+    }
+    static void load_stage1(std::vector<PDB>& pdb) { build_pdb(stage_partition(1),pdb); }
+    static void load_stage2(std::vector<PDB>& pdb) { build_pdb(stage_partition(2),pdb); }
+    static void load_optimal(std::vector<PDB>& pdb) { build_pdb(optimal_partition(),pdb,OPTIMAL_ENCODING); }
+    static inline Tables pdb_stage1{load_stage1};
+    static inline Tables pdb_stage2{load_stage2};
+    static inline Tables pdb_optimal{load_optimal};
+    static inline const std::vector<PDB> no_tables;
+    // The stage tables build in milliseconds, so a staged solve waits this
+    // long for them before searching without; optimal solves never wait.
+    static constexpr int STAGE_TABLE_WAIT_MS=1000;
+    // Optimal solves run on linear conflict alone within these budgets (the
+    // node limit bounds each pass) while the optimal tables load, then fall
+    // back to the staged pipeline.
+    static constexpr int OPTIMAL_FALLBACK_MS=2000;
+    static constexpr long OPTIMAL_FALLBACK_NODES=20000000;
+
+    // Readiness (0 absent, 1 loading, 2 ready) of the tables behind: 0 the
+    // staged solve (placement and region tables), 1 the stage PDBs its
+    // search fallback uses, 2 the optimal solve.
+    static int table_status(int set) {
+        if(set==0) return staged_tables.status();
+        if(set==1) return std::min(pdb_stage1.status(),pdb_stage2.status());
+        return pdb_optimal.status();
+    }
+    // Bytes held by every table built or mapped so far.
+    static size_t pdb_memory() {
+        size_t bytes=PlacementTable<R,C>::memory()+RegionTable<R,C>::memory();
+        for(Tables* set:{&pdb_stage1,&pdb_stage2,&pdb_optimal}) {
+            if(set->status()!=BackgroundBuild::READY) continue;
+            for(const auto& db:*set->acquire()) bytes+=db.memory_bytes();
+        }
+        return bytes;
+    }
+
+    // Stage 1: sum of the stage-1 tables, a lower bound on placing the stage-1
+    // tiles (zero exactly when they are all home). Stage 2: a bound on the full
+    // solve, the larger of the stage-2 sum read for the state, the same sum read
+    // for its mirror image (square boards) and Manhattan. md is the state's
+    // Manhattan distance when the caller already tracks it incrementally; it
+    // is only recomputed when not given.
+    static int pdb_heuristic(const State& state,int stage,int md=-1) {
+        int h=0, hr=0;
+        Snapshot tables=(stage==1?pdb_stage1:pdb_stage2).get();
+        if(!tables) return stage==1?0:md<0?manhattan(state):md;
+        if(stage==1) {
+            for(const auto& db:*tables) h+=db.lookup(state);
+            return h;
+        }
+        for(const auto& db:*tables) {
+            h+=db.lookup(state);
+            if constexpr(R==C) hr+=db.lookup_reflected(state);
+        }
+        if(md<0) md=manhattan(state);
+        return std::max({h,hr,md});
+    }
+
+    // --- Locked positions ---
+    // Lock sets are bit masks over cells: bit i set means cell i is fixed.
+    static uint32_t get_locked_mask(const State& state,int stage) {
+        uint32_t locked=0;
+        if(stage==1) for(int i=0;i<STAGE1_TILES;++i) if(state.at(i)==i+1) locked|=1u<<i;
+        return locked;
+    }
+
+    // --- IDA* with advanced pruning and debug ---
+    // Stage 1 stops as soon as the stage-1 tables read zero; stage 2 searches
+    // for a full solve.
+    // heuristics selects the bounds h maxes over (Heuristic flags), evaluated
+    // lazily from Manhattan up to the table lookups. Stage 1 bounds only the
+    // stage-1 tiles: Manhattan and linear conflict are masked to them and the
+    // walking distance and mirrored tables, which count every tile, are off.
+    // Stage 2 always keeps Manhattan as its floor. Without the stage tables
+    // (still loading) H_PDB falls back to linear conflict.
+    typedef MaxHeuristic<ManhattanSum<R,C>,LinearConflict<R,C>,WalkingDistance<R,C>,PDBSum<R,C>,PDBSum<R,C>> StageHeuristic;
+    struct StagePolicy {
+        typedef typename StageHeuristic::Node Node;
+        int stage;
+        Snapshot tables; // held for the search; a set loaded later serves the next one
+        StageHeuristic heuristic;
+        static uint32_t sources(int st,int hs) {
+            uint32_t on=1;
+            if(hs&H_LINEAR_CONFLICT) on|=2;
+            if(hs&H_WALKING_DISTANCE && st!=1) on|=4;
+            if(hs&H_PDB) on|=st==1?8:(R==C?8|16:8);
+            return on;
+        }
+        explicit StagePolicy(int st,int hs=H_PDB): stage(st),
+            tables((st==1?pdb_stage1:pdb_stage2).acquire(STAGE_TABLE_WAIT_MS)),
+            heuristic(ManhattanSum<R,C>(mask(st)),LinearConflict<R,C>(mask(st)),WalkingDistance<R,C>(),
+                PDBSum<R,C>(tables?*tables:no_tables),PDBSum<R,C>(tables?*tables:no_tables,true),
+                sources(st,tables?hs:(hs&~H_PDB)|(hs&H_PDB?H_LINEAR_CONFLICT:0))) {}
+        static uint32_t mask(int st) { return st==1?(1u<<(STAGE1_TILES+1))-2:~0u; }
+        Node root(const State& s) const { return heuristic.root(s); }
+        Node child(const State& s,const Node& p,int v,int from,int to,int bound) const {
+            return heuristic.child(s,p,v,from,to,bound);
+        }
+        bool is_goal(const State& s,const Node& n) const { return stage==1?n.h==0:s.isSolved(); }
+    };
+
+    // Optimal full solve on additive tables: linear conflict first (cheap and
+    // often enough to cut a child off), then the partition sum and the same
+    // sum read for the mirror image (square boards). The tables cost one
+    // lookup each per move whatever the partition size. Given no tables it
+    // is linear conflict alone, still admissible.
+    typedef MaxHeuristic<LinearConflict<R,C>,PDBSum<R,C>,PDBSum<R,C>> OptimalHeuristic;
+    struct OptimalPolicy {
+        typedef typename OptimalHeuristic::Node Node;
+        OptimalHeuristic heuristic;
+        explicit OptimalPolicy(const std::vector<PDB>& p):
+            heuristic(LinearConflict<R,C>(),PDBSum<R,C>(p),PDBSum<R,C>(p,true),R==C?7:3) {}
+        Node root(const State& s) const { return heuristic.root(s); }
+        Node child(const State& s,const Node& p,int v,int from,int to,int bound) const {
+            return heuristic.child(s,p,v,from,to,bound);
+        }
+        bool is_goal(const State& s,const Node&) const { return s.isSolved(); }
+    };
+
+    // Iterative deepening driver shared by every mode: raises the threshold
+    // to the smallest f that exceeded it until the engine finds a goal, a
+    // pass exceeds node_limit or the time budget runs out, mid-pass included.
+    template<typename Policy>
+    static IDAResult run_ida(const State& start,Policy& policy,long node_limit,int time_limit_ms,uint32_t locked) {
+        typedef IDAEngine<R,C,Policy> Engine;
+        auto deadline=Engine::Clock::now()+std::chrono::milliseconds(time_limit_ms);
+        Engine engine(policy,locked);
+        engine.set_deadline(deadline);
+        State state=start;
+        int threshold=policy.root(state).h;
+        bool found=false;
+        std::string fail_reason;
+        while(true) {
+            int next;
+            auto status=engine.iterate(state,threshold,next,node_limit);
+            if(status==Engine::FOUND) {found=true;break;}
+            if(status==Engine::ABORTED || next==INT_MAX) {fail_reason=engine.timed_out()?"timeout":"search_limit";break;}
+            threshold=next;
+            if(Engine::Clock::now()>deadline) {fail_reason="timeout";break;}
+        }
+        std::vector<uint8_t> path;
+        if(found) path.assign(engine.path(),engine.path()+engine.length());
+        return {path,found,(int)engine.node_count(),(int)path.size(),fail_reason};
+    }
+
+    // --- Parallel IDA* ---
+    // Each pass expands the root breadth-first, pruned by the pass's shared
+    // threshold, until there are enough subtrees for every worker to get many.
+    // They are dealt round-robin onto per-worker deques and searched by one
+    // engine per worker, which steals from the others once its own deque is
+    // empty. Workers fold the smallest f they cut off into the next threshold.
+    // The first solution or the node limit sets a shared stop flag; every
+    // engine checks it and the deadline each 1024 nodes, so all workers stop
+    // within about that many nodes. Any solution found in a pass is optimal,
+    // as in the sequential search.
+    static constexpr int FRONTIER_DEPTH=16;
+    static constexpr int TASKS_PER_WORKER=64;
+    template<typename Policy>
+    static IDAResult run_parallel_ida(const State& start,Policy& policy,long node_limit,int time_limit_ms,uint32_t locked,int threads=0) {
+        typedef IDAEngine<R,C,Policy> Engine;
+        typedef typename Policy::Node Node;
+        struct Task { State s; Node node; int16_t q; uint8_t g; uint8_t path[FRONTIER_DEPTH]; };
+        int workers=worker_count(threads);
+        if(workers<2) return run_ida(start,policy,node_limit,time_limit_ms,locked);
+        auto deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(time_limit_ms);
+        const auto cells=Moves::open(locked);
+        const MoveFSM& fsm=MoveFSM::get();
+        int threshold=policy.root(start).h;
+        long pass_nodes=0;
+        while(true) {
+            // Frontier for this pass; a goal on the way ends the search.
+            std::vector<Task> frontier{{start,policy.root(start),0,0,{}}};
+            if(policy.is_goal(start,frontier[0].node)) return {{},true,1,0,""};
+            int next=INT_MAX;
+            pass_nodes=1;
+            for(int g=0;g<FRONTIER_DEPTH && frontier.size()<(size_t)workers*TASKS_PER_WORKER;++g) {
+                std::vector<Task> level;
+                for(Task& t:frontier) {
+                    const auto& cell=cells[t.s.empty];
+                    for(int k=0;k<cell.count;++k) {
+                        int q=fsm.next(t.q,cell.moves[k].dir);
+                        if(q<0) continue;
+                        Task c=t;
+                        int from=c.s.empty, to=cell.moves[k].to;
+                        uint8_t v=c.s.at(to);
+                        c.s.slide(to);
+                        c.node=policy.child(c.s,t.node,v,to,from,threshold-g-1);
+                        ++pass_nodes;
+                        int fv=g+1+c.node.h;
+                        if(fv>threshold) {next=std::min(next,fv);continue;}
+                        c.q=(int16_t)q;
+                        c.path[g]=v;
+                        c.g=(uint8_t)(g+1);
+                        if(policy.is_goal(c.s,c.node)) return {{c.path,c.path+c.g},true,(int)pass_nodes,(int)c.g,""};
+                        level.push_back(c);
+                    }
+                }
+                frontier.swap(level);
+                if(frontier.empty()) break;
+            }
+
+            TaskDeques deques(workers);
+            for(size_t i=0;i<frontier.size();++i) deques.push((int)(i%workers),i);
+            std::atomic<bool> stop(false);
+            std::atomic<int> pass_next(next);
+            std::atomic<long> nodes(pass_nodes);
+            std::mutex mu;
+            std::vector<uint8_t> path;
+            std::string fail_reason;
+            auto halt=[&](const char* reason) {
+                std::lock_guard<std::mutex> lock(mu);
+                if(!stop) fail_reason=reason, stop=true;
+            };
+            auto work=[&](int w) {
+                Engine engine(policy,locked);
+                engine.set_stop(&stop);
+                engine.set_deadline(deadline);
+                size_t i;
+                while(!stop.load(std::memory_order_relaxed) && deques.pop(w,i)) {
+                    Task& t=frontier[i];
+                    int sub_next;
+                    auto status=engine.search(t.s,t.node,t.q,threshold-t.g,sub_next,node_limit);
+                    long total=nodes+=engine.node_count();
+                    if(status==Engine::FOUND) {
+                        std::lock_guard<std::mutex> lock(mu);
+                        if(!stop) {
+                            path.assign(t.path,t.path+t.g);
+                            path.insert(path.end(),engine.path(),engine.path()+engine.length());
+                            stop=true;
+                        }
+                    } else if(status==Engine::CUTOFF && sub_next!=INT_MAX) {
+                        int f=sub_next+t.g, cur=pass_next.load();
+                        while(f<cur && !pass_next.compare_exchange_weak(cur,f)) {}
+                    }
+                    if(status==Engine::ABORTED && engine.timed_out()) halt("timeout");
+                    else if(status==Engine::ABORTED || total>node_limit) halt("search_limit");
+                }
+            };
+            std::vector<std::thread> pool;
+            for(int w=1;w<workers;++w) pool.emplace_back(work,w);
+            work(0);
+            for(auto& th:pool) th.join();
+
+            pass_nodes=nodes;
+            if(!path.empty()) return {path,true,(int)pass_nodes,(int)path.size(),""};
+            if(!fail_reason.empty()) return {{},false,(int)pass_nodes,0,fail_reason};
+            if(pass_next==INT_MAX) return {{},false,(int)pass_nodes,0,"search_limit"};
+            threshold=pass_next;
+            if(std::chrono::steady_clock::now()>deadline) return {{},false,(int)pass_nodes,0,"timeout"};
+        }
+    }
+
+    static IDAResult ida_star(const State& start,int max_depth,int stage=2,int node_limit=1000000,int time_limit_ms=20000,uint32_t locked=0,int heuristics=H_PDB) {
+        StagePolicy policy(stage,heuristics);
+        return run_ida(start,policy,node_limit,time_limit_ms,locked);
+    }
+
+    // --- Staged solve: placement subgoals, then an exact region ---
+    // Subgoals in order. While more than a 4x4 is left: its top row, then its
+    // left column (on the 5x5, first row and column reduce it to a 4x4). Then
+    // the 4x4's top row and the two cells below its left end, which leaves
+    // the 10 cells RegionTable finishes. A line's last two tiles go home
+    // together: with the rest of the line locked, a lone last tile could only
+    // enter its corner from the cell where the blank would have to be.
+    static std::vector<std::vector<uint8_t>> placement_plan() {
+        std::vector<std::vector<uint8_t>> plan;
+        auto line=[&](int first,int count,int step) {
+            for(int k=0;k<count-2;++k) plan.push_back({(uint8_t)(first+k*step+1)});
+            int last=first+(count-2)*step+1;
+            plan.push_back({(uint8_t)last,(uint8_t)(last+step)});
+        };
+        int top=0;
+        for(;R-top>4 || C-top>4;++top) {
+            line(top*C+top,C-top,1);
+            line((top+1)*C+top,R-top-1,C);
+        }
+        line(top*C+top,C-top,1);
+        plan.push_back({(uint8_t)((top+1)*C+top+1)});
+        plan.push_back({(uint8_t)((top+1)*C+top+2)});
+        return plan;
+    }
+    static uint32_t plan_mask(const std::vector<std::vector<uint8_t>>& plan) {
+        uint32_t locked=0;
+        for(const auto& group:plan) for(uint8_t v:group) locked|=1u<<(v-1);
+        return locked;
+    }
+    // IDA* on the exact placement distance: the first pass finds the goal, so
+    // a placement costs its length times the branching factor.
+    struct PlacementPolicy {
+        struct Node { int h; };
+        const PlacementTable<R,C>& table;
+        Node root(const State& s) const { return {table.distance(s)}; }
+        Node child(const State& s,const Node&,int,int,int,int) const { return {table.distance(s)}; }
+        bool is_goal(const State&,const Node& n) const { return n.h==0; }
+    };
+    static IDAResult place(const State& start,const std::vector<uint8_t>& tiles,uint32_t locked) {
+        PlacementPolicy policy{PlacementTable<R,C>::get(tiles,locked)};
+        if(policy.root(start).h==PlacementTable<R,C>::UNREACHABLE) return {{},false,0,0,"unreachable"};
+        return run_ida(start,policy,LONG_MAX,INT_MAX,locked);
+    }
+    // Places and locks the plan's tiles, appending the moves; false only
+    // when a subgoal is unreachable.
+    static bool solve_placements(State& cur,uint32_t& locked,std::vector<uint8_t>& moves) {
+        for(const auto& group:placement_plan()) {
+            bool home=true;
+            for(uint8_t v:group) home&=cur.at(v-1)==v;
+            if(!home) {
+                auto res=place(cur,group,locked);
+                if(!res.success) {DEBUG_LOG(1,"Placement fail: "+vec2str(group));return false;}
+                apply_moves(cur,res.moves);
+                moves.insert(moves.end(),res.moves.begin(),res.moves.end());
+            }
+            for(uint8_t v:group) locked|=1u<<(v-1);
+        }
+        return true;
+    }
+
+    // Finishes a board whose locked cells hold their own tiles by descending
+    // the remaining region's exact table: no search, and optimal for the
+    // region. False when the region is too large for a table.
+    static bool solve_region(State& cur,uint32_t locked,std::vector<uint8_t>& moves) {
+        if(!RegionTable<R,C>::fits(locked)) return false;
+        return RegionTable<R,C>::get(locked).descend(cur,moves);
+    }
+    // The whole staged solve; every step is a table walk, so its time does
+    // not depend on the board. Should a step fail, the search below gets a
+    // bounded try instead. The first solve starts the tables building in the
+    // background and meanwhile tries the search for about as long as the
+    // build takes, waiting for the tables only when that fails.
+    static constexpr int SEARCH_FALLBACK_MS=5000;
+    static constexpr int BUILDING_SEARCH_MS=1000;
+    static bool solve_staged(const State& start,std::vector<uint8_t>& moves) {
+        if(!staged_tables.ready()) {
+            DEBUG_LOG(2,"staged tables building, searching meanwhile");
+            if(solve_searched(start,moves,BUILDING_SEARCH_MS)) return true;
+            moves.clear();
+            staged_tables.wait();
+        }
+        State cur=start;
+        uint32_t locked=0;
+        if(solve_placements(cur,locked,moves) && solve_region(cur,locked,moves)) return true;
+        DEBUG_LOG(1,"Staged tables failed, searching");
+        moves.clear();
+        return solve_searched(start,moves,SEARCH_FALLBACK_MS);
     }
-}
+
+    // --- Staged solve by search ---
+    // The table-free pipeline: IDA* brings the stage-1 tiles home on the
+    // stage-1 sums and linear conflict, then finishes on the lazy max of
+    // Manhattan, linear conflict, walking distance (4x4) and the stage-2 sums,
+    // with bidirectional BFS as a last resort. Bounded by node limits and
+    // time_limit_ms, so it can fail on hard boards.
+    static constexpr int STAGE1_NODES=N<=16?300000:250000;
+    static constexpr int STAGE2_NODES=N<=16?800000:400000;
+    static constexpr int SEARCH_DEPTH=N<=16?40:60;
+    static bool solve_searched(const State& start,std::vector<uint8_t>& moves,int time_limit_ms) {
+        auto deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(time_limit_ms);
+        auto left=[&]() {
+            auto ms=std::chrono::duration_cast<std::chrono::milliseconds>(deadline-std::chrono::steady_clock::now()).count();
+            return (int)std::max<long long>(ms,0);
+        };
+        const uint32_t stage1=(1u<<STAGE1_TILES)-1;
+        State cur=start;
+        if(get_locked_mask(cur,1)!=stage1) {
+            auto res=ida_star(cur,N<=16?18:25,1,STAGE1_NODES,left(),0,H_PDB|H_LINEAR_CONFLICT);
+            if(!res.success) {DEBUG_LOG(1,"Stage1 search fail: "+res.fail_reason);return false;}
+            apply_moves(cur,res.moves);
+            moves.insert(moves.end(),res.moves.begin(),res.moves.end());
+        }
+        uint32_t locked=get_locked_mask(cur,1);
+        auto res=ida_star(cur,SEARCH_DEPTH,2,STAGE2_NODES,left(),locked,H_PDB|H_LINEAR_CONFLICT|(N<=16?H_WALKING_DISTANCE:0));
+        if(res.success) {
+            moves.insert(moves.end(),res.moves.begin(),res.moves.end());
+            return true;
+        }
+        auto bfs=bibfs(cur,SEARCH_DEPTH,2,200000,locked);
+        if(!bfs.success) {DEBUG_LOG(1,"Stage2 search fail: "+bfs.fail_reason);return false;}
+        moves.insert(moves.end(),bfs.moves.begin(),bfs.moves.end());
+        return true;
+    }
+    // Builds every table the staged solve uses (the region table is the only
+    // one that takes noticeable time).
+    static void prepare_staged() {
+        auto plan=placement_plan();
+        uint32_t locked=0;
+        for(const auto& group:plan) {
+            PlacementTable<R,C>::get(group,locked);
+            for(uint8_t v:group) locked|=1u<<(v-1);
+        }
+        RegionTable<R,C>::get(locked);
+    }
+    static inline BackgroundBuild staged_tables{prepare_staged};
+
+    // Runs on every hardware thread unless threads says otherwise.
+    static IDAResult ida_star_optimal(const State& start,const std::vector<PDB>& tables,long node_limit,int time_limit_ms,int threads=0) {
+        OptimalPolicy policy(tables);
+        return run_parallel_ida(start,policy,node_limit,time_limit_ms,0,threads);
+    }
+
+    // Optimal solve on whatever is ready: the optimal tables, or while they
+    // load in the background a short search on linear conflict. The result
+    // fails when neither finishes in time; callers then go staged.
+    static IDAResult solve_optimal(const State& start,int time_limit_ms) {
+        Snapshot tables=pdb_optimal.acquire();
+        if(tables) return ida_star_optimal(start,*tables,LONG_MAX,time_limit_ms);
+        DEBUG_LOG(2,"optimal tables loading, searching on linear conflict");
+        return ida_star_optimal(start,no_tables,OPTIMAL_FALLBACK_NODES,std::min(time_limit_ms,OPTIMAL_FALLBACK_MS));
+    }
+
+    // --- Bidirectional BFS ---
+    static BiBFSResult bibfs(const State& start,int max_depth,int stage=2,int node_limit=200000,uint32_t locked=0) {
+        State goal=State::goal();
+        const MoveFSM& fsm=MoveFSM::get();
+        std::queue<std::tuple<State,std::vector<uint8_t>,int>> Q;
+        std::unordered_set<State,PuzzleHash> Vis;
+        Q.push({start,{},0});
+        Vis.insert(start);
+        int nodes=0;
+        const auto cells=Moves::open(locked);
+        while(!Q.empty() && nodes<node_limit) {
+            auto [state,moves,q]=Q.front(); Q.pop();
+            nodes++;
+            if(state==goal) return {moves,true,nodes,(int)moves.size(),""};
+            if((int)moves.size()>=max_depth) continue;
+            const auto& cell=cells[state.empty];
+            for(int k=0;k<cell.count;++k) {
+                int ni=cell.moves[k].to, nq=fsm.next(q,cell.moves[k].dir);
+                if(nq<0) continue;
+                State nxt=state;
+                nxt.slide(ni);
+                if(Vis.count(nxt)) continue;
+                Vis.insert(nxt);
+                auto nmoves=moves;
+                nmoves.push_back(nxt.at(state.empty));
+                Q.push({nxt,nmoves,nq});
+            }
+        }
+        return {{},false,nodes,0,"failed"};
+    }
+
+    // --- Move Application ---
+    static void apply_moves(State& state,const std::vector<uint8_t>& moves) {
+        for(auto mv:moves) state.move_tile(mv);
+    }
+};
 
 // --- Stage-wise Solving Logic ---
-int solve_4x4(const PuzzleState& start,uint8_t* moves_out) {
+typedef Solver<4,4> Solver4;
+typedef Solver<5,5> Solver5;
+
+// Staged: place and lock tiles one subgoal at a time, then walk the last 10
+// cells' exact table (fast, not optimal).
+// Optimal: one IDA* over the whole board on the additive PDBs; staged when
+// that does not finish (or the tables are still loading and linear conflict
+// alone is not enough).
+enum SolveMode { MODE_STAGED=0, MODE_OPTIMAL=1 };
+
+int solve_4x4(const Solver4::State& start,uint8_t* moves_out,int mode=MODE_STAGED) {
+    if(mode==MODE_OPTIMAL) {
+        auto res=Solver4::solve_optimal(start,30000);
+        if(res.success) {
+            std::copy(res.moves.begin(),res.moves.end(),moves_out);
+            return res.length;
+        }
+        DEBUG_LOG(1,"4x4 optimal fail: "+res.fail_reason+", using staged");
+    }
     std::vector<uint8_t> all_moves;
-    PuzzleState cur=start;
-    std::set<int> locked;
-    int sz=4,max_depth=18;
-    if(pdb_4x4_stage1.empty()) build_pdb(4,6,pdb_4x4_stage1,14);
-    for(int i=0;i<6;i++) {
-        int goal_idx=i;
-        if(cur.tiles[goal_idx]==i+1) {locked.insert(goal_idx);continue;}
-        auto res=ida_star(cur,sz,max_depth,1,300000,4000,locked);
-        if(!res.success) {DEBUG_LOG(1,"4x4 Stage1 fail: "+std::to_string(i+1));return -1;}
-        apply_moves(cur,res.moves);
-        all_moves.insert(all_moves.end(),res.moves.begin(),res.moves.end());
-        locked.insert(goal_idx);
-    }
-    auto res2=ida_star(cur,sz,40,2,800000,16000,locked);
-    if(res2.success) {
-        apply_moves(cur,res2.moves);
-        all_moves.insert(all_moves.end(),res2.moves.begin(),res2.moves.end());
-        for(size_t i=0;i<all_moves.size();i++) moves_out[i]=all_moves[i];
-        return (int)all_moves.size();
-    }
-    auto res3=bibfs(cur,sz,40,2,200000,locked);
-    if(res3.success) {
-        apply_moves(cur,res3.moves);
-        all_moves.insert(all_moves.end(),res3.moves.begin(),res3.moves.end());
-        for(size_t i=0;i<all_moves.size();i++) moves_out[i]=all_moves[i];
-        return (int)all_moves.size();
-    }
-    return -1;
+    if(!Solver4::solve_staged(start,all_moves)) return -1;
+    std::copy(all_moves.begin(),all_moves.end(),moves_out);
+    return (int)all_moves.size();
 }
 
-int solve_5x5(const PuzzleState& start,uint8_t* moves_out) {
+// The 24-puzzle's hardest instances need far more than an interactive time
+// budget even on 6-6-6-6 tables, so optimal mode often ends up staged. Staged
+// places the first row and column, then solves the 4x4 left like a 4x4.
+int solve_5x5(const Solver5::State& start,uint8_t* moves_out,int mode=MODE_STAGED) {
+    if(mode==MODE_OPTIMAL) {
+        auto res=Solver5::solve_optimal(start,30000);
+        if(res.success) {
+            std::copy(res.moves.begin(),res.moves.end(),moves_out);
+            return res.length;
+        }
+        DEBUG_LOG(1,"5x5 optimal fail: "+res.fail_reason+", using staged");
+    }
     std::vector<uint8_t> all_moves;
-    PuzzleState cur=start;
-    std::set<int> locked;
-    int sz=5,max_depth=25;
-    if(pdb_5x5_stage1.empty()) build_pdb(5,12,pdb_5x5_stage1,16);
-    for(int i=0;i<12;i++) {
-        int goal_idx=i;
-        if(cur.tiles[goal_idx]==i+1) {locked.insert(goal_idx);continue;}
-        auto res=ida_star(cur,sz,max_depth,1,250000,3000,locked);
-        if(!res.success) {DEBUG_LOG(1,"5x5 Stage1 fail: "+std::to_string(i+1));return -1;}
-        apply_moves(cur,res.moves);
-        all_moves.insert(all_moves.end(),res.moves.begin(),res.moves.end());
-        locked.insert(goal_idx);
-    }
-    std::vector<std::thread> threads;
-    std::vector<ThreadResult> results(4);
-    std::atomic<bool> found(false);
-    int time_limit=9000;
-    for(int t=0;t<4;t++) {
-        threads.emplace_back([&,t](){
-            results[t]=thread_ida_search(cur,sz,60,2,400000,time_limit,locked);
-            if(results[t].success) found=true;
-        });
-    }
-    for(auto& th:threads) th.join();
-    for(int t=0;t<4;t++) {
-        if(results[t].success) {
-            apply_moves(cur,results[t].moves);
-            all_moves.insert(all_moves.end(),results[t].moves.begin(),results[t].moves.end());
-            for(size_t i=0;i<all_moves.size();i++) moves_out[i]=all_moves[i];
-            return (int)all_moves.size();
-        }
-    }
-    auto res3=bibfs(cur,sz,60,2,400000,locked);
-    if(res3.success) {
-        apply_moves(cur,res3.moves);
-        all_moves.insert(all_moves.end(),res3.moves.begin(),res3.moves.end());
-        for(size_t i=0;i<all_moves.size();i++) moves_out[i]=all_moves[i];
-        return (int)all_moves.size();
-    }
-    return -1;
+    if(!Solver5::solve_staged(start,all_moves)) return -1;
+    std::copy(all_moves.begin(),all_moves.end(),moves_out);
+    return (int)all_moves.size();
 }
 
 // --- Diagnostics, validation, fallback ---
-bool validate_input(const PuzzleState& s) {
-    int sz=s.size;
-    std::vector<int> cnt(sz*sz,0);
-    for(int i=0;i<sz*sz;++i) cnt[s.tiles[i]]++;
-    for(int i=0;i<sz*sz;++i) if(cnt[i]!=1) return false;
+template<int R,int C>
+bool validate_input(const PuzzleState<R,C>& s) {
+    std::vector<int> cnt(R*C,0);
+    for(int i=0;i<R*C;++i) cnt[s.at(i)]++;
+    for(int i=0;i<R*C;++i) if(cnt[i]!=1) return false;
+    // Half of all permutations cannot reach the goal; reject them here rather
+    // than let IDA* exhaust its budget. With an odd width the inversion count
+    // must be even; with an even width it must have the parity of the blank's
+    // row distance from the bottom.
+    int inversions=0;
+    for(int i=0;i<R*C;++i) for(int j=i+1;j<R*C;++j)
+        if(s.at(i) && s.at(j) && s.at(i)>s.at(j)) ++inversions;
+    if(C%2==0) inversions+=R-1-s.empty/C;
+    return inversions%2==0;
+}
+
+// Runs f with a value-initialised Solver<sz,sz> so the callee can recover the
+// board type as decltype(solver)::State; unsupported sizes return fallback.
+template<typename F>
+int with_solver(int sz,int fallback,F&& f) {
+    if(sz==4) return f(Solver4());
+    if(sz==5) return f(Solver5());
+    return fallback;
+}
+
+// True when arr holds each of 0..N-1 exactly once. A State indexes its tables
+// by tile value, so no board from outside may reach one unchecked.
+template<int N>
+bool valid_tiles(const uint8_t* arr) {
+    uint32_t seen=0;
+    for(int i=0;i<N;++i) {
+        if(arr[i]>=N || seen>>arr[i]&1) return false;
+        seen|=1u<<arr[i];
+    }
     return true;
 }
+// with_solver for exports that take a board: f also gets the State, built
+// only once arr has passed valid_tiles; otherwise fallback.
+template<typename F>
+int with_board(const uint8_t* arr,int sz,int fallback,F&& f) {
+    return with_solver(sz,fallback,[&](auto solver) {
+        typedef typename decltype(solver)::State State;
+        if(!arr || !valid_tiles<State::N>(arr)) {DEBUG_LOG(1,"Invalid input");return fallback;}
+        return f(solver,State(arr));
+    });
+}
 
 // --- Entry point ---
 extern "C" {
 EMSCRIPTEN_KEEPALIVE
-int solve_puzzle(uint8_t* arr,int sz,uint8_t* moves_out) {
+int solve_puzzle_mode(uint8_t* arr,int sz,int mode,uint8_t* moves_out) {
     try {
-        PuzzleState start(arr,sz);
+        if(sz!=4 && sz!=5) return -1;
+        if(!arr || !(sz==4?valid_tiles<16>(arr):valid_tiles<25>(arr))) {DEBUG_LOG(1,"Invalid input");return -1;}
+        if(sz==4) {
+            Solver4::State start(arr);
+            if(!validate_input(start)) {DEBUG_LOG(1,"Invalid input");return -1;}
+            if(start.isSolved()) return 0;
+            int r=solve_4x4(start,moves_out,mode);if(r>0)return r;return -1;
+        }
+        Solver5::State start(arr);
         if(!validate_input(start)) {DEBUG_LOG(1,"Invalid input");return -1;}
         if(start.isSolved()) return 0;
-        if(sz==4) {int r=solve_4x4(start,moves_out);if(r>0)return r;return -1;}
-        if(sz==5) {int r=solve_5x5(start,moves_out);if(r>0)return r;return -1;}
-        return -1;
+        int r=solve_5x5(start,moves_out,mode);if(r>0)return r;return -1;
     } catch(const std::exception& ex) {
         DEBUG_LOG(1,std::string("Exception: ")+ex.what());
         return -1;
@@ -441,59 +2400,115 @@ int solve_puzzle(uint8_t* arr,int sz,uint8_t* moves_out) {
         return -1;
     }
 }
+EMSCRIPTEN_KEEPALIVE
+int solve_puzzle(uint8_t* arr,int sz,uint8_t* moves_out) {
+    return solve_puzzle_mode(arr,sz,MODE_STAGED,moves_out);
+}
 
 // --- Extra debug/test utilities ---
 EMSCRIPTEN_KEEPALIVE
 int test_pdb_build(int sz,int ntiles) {
-    std::unordered_map<std::string,int> pdb;
-    build_pdb(sz,ntiles,pdb,12);
-    return (int)pdb.size();
+    return with_solver(sz,0,[&](auto solver) {
+        typedef typename decltype(solver)::State State;
+        if(ntiles<1 || ntiles>6 || ntiles>=State::N) return 0;
+        std::vector<uint8_t> pattern;
+        for(int v=1;v<=ntiles;++v) pattern.push_back(v);
+        typename decltype(solver)::PDB pdb(pattern);
+        pdb.build();
+        return (int)pdb.size();
+    });
+}
+// Directory pattern databases are mapped from and saved to ("" disables).
+EMSCRIPTEN_KEEPALIVE
+void set_pdb_directory(const char* dir) { pdb_directory=dir?dir:""; }
+// 1 when a table file's header and payload checksum are intact.
+EMSCRIPTEN_KEEPALIVE
+int verify_pdb_file(const char* path) {
+    std::string err=check_pdb_file(path);
+    if(!err.empty()) DEBUG_LOG(1,std::string("PDB file ")+path+": "+err);
+    return err.empty();
+}
+// Starts loading the tables a mode uses in the background, so the first
+// solve in that mode does not have to wait or fall back.
+EMSCRIPTEN_KEEPALIVE
+void preload_pdbs(int sz,int mode) {
+    with_solver(sz,0,[&](auto solver) {
+        typedef decltype(solver) S;
+        if(mode==MODE_OPTIMAL) S::pdb_optimal.request();
+        else S::staged_tables.request();
+        return 0;
+    });
+}
+// 0 absent, 1 loading, 2 ready. Set 0 is what staged mode solves on, 1 the
+// PDBs of its search fallback, 2 the optimal tables.
+EMSCRIPTEN_KEEPALIVE
+int get_pdb_status(int sz,int set) {
+    if(set<0 || set>2) return -1;
+    return with_solver(sz,-1,[&](auto solver) { return decltype(solver)::table_status(set); });
+}
+// Kilobytes held by the solver's tables built so far for this board size.
+EMSCRIPTEN_KEEPALIVE
+int get_pdb_memory_kb(int sz) {
+    return with_solver(sz,-1,[&](auto solver) { return (int)((decltype(solver)::pdb_memory()+1023)>>10); });
 }
 EMSCRIPTEN_KEEPALIVE
 void shuffle_state(uint8_t* arr,int sz,int times) {
-    std::random_device rd; std::mt19937 gen(rd());
-    for(int t=0;t<times;t++) {
+    with_solver(sz,0,[&](auto solver) {
+        typedef typename decltype(solver)::Moves Moves;
+        std::random_device rd; std::mt19937 gen(rd());
         int empty=-1;
         for(int i=0;i<sz*sz;i++) if(arr[i]==0) empty=i;
-        int r=empty/sz, c=empty%sz;
-        std::vector<int> opt;
-        for(int d=0;d<4;d++) {
-            int nr=r+dir4[d][0], nc=c+dir4[d][1];
-            if(nr<0||nr>=sz||nc<0||nc>=sz) continue;
-            opt.push_back(nr*sz+nc);
+        if(empty<0) return 0;
+        for(int t=0;t<times;t++) {
+            const auto& cell=Moves::cells[empty];
+            int ni=cell.moves[gen()%cell.count].to;
+            std::swap(arr[empty],arr[ni]);
+            empty=ni;
         }
-        if(opt.empty()) continue;
-        int ni=opt[gen()%opt.size()];
-        std::swap(arr[empty],arr[ni]);
-    }
+        return 0;
+    });
 }
 EMSCRIPTEN_KEEPALIVE
 void print_state(uint8_t* arr,int sz) {
 #if LOG_LEVEL>1
-    PuzzleState s(arr,sz);
-    DEBUG_LOG(2,"State: "+vec2str(s.tiles));
+    with_board(arr,sz,0,[&](auto,const auto& s) {
+        DEBUG_LOG(2,"State: "+vec2str(s.tiles()));
+        return 0;
+    });
 #endif
 }
 EMSCRIPTEN_KEEPALIVE
 int validate_solution(uint8_t* arr,int sz,uint8_t* moves,int n_moves) {
-    PuzzleState s(arr,sz);
-    for(int i=0;i<n_moves;i++) {
-        int mv=moves[i], from=-1;
-        for(int j=0;j<sz*sz;j++) if(s.tiles[j]==mv) from=j;
-        std::swap(s.tiles[s.empty],s.tiles[from]);
-        s.empty=from;
-    }
-    return s.isSolved()?1:0;
+    return with_board(arr,sz,0,[&](auto solver,auto s) {
+        typedef typename decltype(solver)::State State;
+        for(int i=0;i<n_moves;i++) {
+            int mv=moves[i];
+            if(mv<1 || mv>=State::N || !State::adjacent(s.pos[mv],s.empty)) return 0;
+            s.move_tile(mv);
+        }
+        return s.isSolved()?1:0;
+    });
 }
 EMSCRIPTEN_KEEPALIVE
 int get_manhattan(uint8_t* arr,int sz) {
-    PuzzleState s(arr,sz);
-    return manhattan(s);
+    return with_board(arr,sz,-1,[&](auto,const auto& s) {
+        return manhattan(s);
+    });
+}
+// 4x4 only (-1 for 5x5): the 5x5 tables take about 66MB and seconds to
+// build, too much to spend on a diagnostic in the WASM build.
+EMSCRIPTEN_KEEPALIVE
+int get_walking_distance(uint8_t* arr,int sz) {
+    if(sz!=4) return -1;
+    return with_board(arr,sz,-1,[&](auto,const auto& s) {
+        return walking_distance(s);
+    });
 }
 EMSCRIPTEN_KEEPALIVE
 int get_pdb_heuristic(uint8_t* arr,int sz,int stage) {
-    PuzzleState s(arr,sz);
-    return pdb_heuristic(s,stage,sz);
+    return with_board(arr,sz,-1,[&](auto solver,const auto& s) {
+        return decltype(solver)::pdb_heuristic(s,stage);
+    });
 }
 }
 
@@ -0,0 +1,156 @@
+/*
+ * Pattern database generator — native command-line build of the solver code
+ * Builds a configured PDB set and writes it in the binary format the solver
+ * maps at runtime (set_pdb_directory), so table construction happens in the
+ * build pipeline instead of on the first solve.
+ *
+ * Build:  g++ -std=c++17 -O2 -pthread src/wasm/pdb_generator.cpp -o pdb_generator
+ * Usage:  pdb_generator --size 4|5 [--set stage1|stage2|optimal] [--partition 1,2,3/4,5,6]
+ *                       [--encoding byte|nibble|mod3] [--block N] [--threads N] [--out DIR]
+ *         pdb_generator --verify FILE...
+ *         pdb_generator --fsm FILE | --verify-fsm
+ * --fsm writes the move-pruning automaton the solver embeds (move_fsm.inc);
+ * --verify-fsm checks the embedded copy against a fresh enumeration.
+ * A partition lists groups separated by '/', tiles by ','; 0 is the blank.
+ * Without --encoding each set uses the storage the solver expects for it.
+ */
+
+#include "advanced_solver.cpp"
+#include <sys/resource.h>
+
+namespace {
+
+struct Options {
+    int size=4;
+    std::string set="optimal";
+    std::string partition;
+    std::string encoding;
+    int block=1;
+    int threads=0;
+    std::string out=".";
+    std::vector<std::string> verify;
+};
+
+int usage() {
+    std::cerr<<"usage: pdb_generator --size 4|5 [--set stage1|stage2|optimal] [--partition 1,2,3/4,5,6]\n"
+               "                     [--encoding byte|nibble|mod3] [--block N] [--threads N] [--out DIR]\n"
+               "       pdb_generator --verify FILE...\n"
+               "       pdb_generator --fsm FILE | --verify-fsm\n";
+    return 2;
+}
+
+bool parse_encoding(const std::string& name,PDBEncoding& enc) {
+    if(name=="byte") enc=PDB_BYTE;
+    else if(name=="nibble") enc=PDB_NIBBLE;
+    else if(name=="mod3") enc=PDB_MOD3;
+    else return false;
+    return true;
+}
+
+bool parse_partition(const std::string& text,int n,std::vector<std::vector<uint8_t>>& groups) {
+    std::vector<bool> used(n,false);
+    std::stringstream groups_in(text);
+    for(std::string group;std::getline(groups_in,group,'/');) {
+        groups.emplace_back();
+        std::stringstream tiles_in(group);
+        for(std::string tile;std::getline(tiles_in,tile,',');) {
+            int v=std::atoi(tile.c_str());
+            if(tile.empty() || v<0 || v>=n || used[v]) return false;
+            used[v]=true;
+            groups.back().push_back(v);
+        }
+        if(groups.back().empty()) return false;
+    }
+    return !groups.empty();
+}
+
+long peak_rss_kb() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF,&ru);
+    return ru.ru_maxrss; // kilobytes on Linux
+}
+
+template<typename S>
+int generate(const Options& opt) {
+    std::vector<std::vector<uint8_t>> groups;
+    PDBEncoding enc=PDB_BYTE;
+    if(!opt.partition.empty()) {
+        if(!parse_partition(opt.partition,S::N,groups)) {std::cerr<<"bad partition: "<<opt.partition<<"\n";return 2;}
+    } else if(opt.set=="stage1" || opt.set=="stage2") {
+        groups=S::stage_partition(opt.set=="stage1"?1:2);
+    } else if(opt.set=="optimal") {
+        groups=S::optimal_partition();
+        enc=S::OPTIMAL_ENCODING;
+    } else return usage();
+    if(!opt.encoding.empty() && !parse_encoding(opt.encoding,enc)) return usage();
+    int threads=worker_count(opt.threads);
+    std::cout<<"size "<<opt.size<<"x"<<opt.size<<", "<<groups.size()<<" tables, "<<threads<<" threads\n";
+    for(const auto& g:groups) {
+        typename S::PDB db(g,enc,opt.block);
+        auto start=std::chrono::steady_clock::now();
+        db.build(threads);
+        double secs=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        std::string path=opt.out+"/"+db.file_name();
+        if(!db.save(path)) {std::cerr<<"cannot write "<<path<<"\n";return 1;}
+        std::cout<<path<<": "<<db.size()<<" states in "<<secs<<" s ("<<(long)(db.size()/std::max(secs,1e-9))
+                 <<" states/s), "<<db.memory_bytes()<<" bytes, peak RSS "<<peak_rss_kb()/1024<<" MB\n";
+    }
+    return 0;
+}
+
+int verify(const std::vector<std::string>& files) {
+    int bad=0;
+    for(const auto& f:files) {
+        PDBFileHeader h;
+        std::string err=check_pdb_file(f,&h);
+        if(err.empty()) std::cout<<f<<": ok, "<<(int)h.rows<<"x"<<(int)h.cols<<", "<<h.entries<<" entries\n";
+        else {std::cout<<f<<": "<<err<<"\n";++bad;}
+    }
+    return bad?1:0;
+}
+
+int write_fsm(const std::string& path) {
+    std::vector<int16_t> t=MoveFSM::generate();
+    std::ofstream out(path);
+    out<<"// Generated by pdb_generator --fsm; do not edit. MoveFSM transitions for\n"
+         "// paths up to "<<MoveFSM::DEPTH<<" moves: "<<t.size()/4<<" states, four directions each.\n";
+    for(size_t i=0;i<t.size();++i) out<<t[i]<<(i+1==t.size()?"\n":i%16==15?",\n":",");
+    out.close();
+    if(!out) {std::cerr<<"cannot write "<<path<<"\n";return 1;}
+    std::cout<<path<<": "<<t.size()/4<<" states\n";
+    return 0;
+}
+
+int verify_fsm() {
+    bool ok=MoveFSM::verify();
+    std::cout<<"embedded move automaton ("<<MoveFSM::states()<<" states): "<<(ok?"ok":"stale, regenerate with --fsm")<<"\n";
+    return ok?0:1;
+}
+
+} // namespace
+
+int main(int argc,char** argv) {
+    Options opt;
+    for(int i=1;i<argc;++i) {
+        std::string arg=argv[i];
+        if(arg=="--verify") {
+            while(i+1<argc) opt.verify.push_back(argv[++i]);
+            return opt.verify.empty()?usage():verify(opt.verify);
+        }
+        if(arg=="--verify-fsm") return verify_fsm();
+        if(i+1>=argc) return usage();
+        std::string val=argv[++i];
+        if(arg=="--size") opt.size=std::atoi(val.c_str());
+        else if(arg=="--set") opt.set=val;
+        else if(arg=="--partition") opt.partition=val;
+        else if(arg=="--encoding") opt.encoding=val;
+        else if(arg=="--block") opt.block=std::atoi(val.c_str());
+        else if(arg=="--threads") opt.threads=std::atoi(val.c_str());
+        else if(arg=="--out") opt.out=val;
+        else if(arg=="--fsm") return write_fsm(val);
+        else return usage();
+    }
+    if(opt.size==4) return generate<Solver4>(opt);
+    if(opt.size==5) return generate<Solver5>(opt);
+    return usage();
+}